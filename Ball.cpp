@@ -1,5 +1,6 @@
 #pragma once
 #include "ball.h"
+#include "Profiler.h"
 
 //returns the magnitude (length) of the argument vector
 float magnitude(const sf::Vector2f &v)
@@ -67,6 +68,123 @@ sf::Vector2f proj(const sf::Vector2f &v, const sf::Vector2f &w)
 	return dot(w, v) / dot(w, w) * w;
 }
 
+//color of balls made of the specified material
+sf::Color get_material_color(Material mat)
+{
+	switch (mat)
+	{
+	case WOOD:  return TAN;
+	case STONE: return GRAY;
+	case IRON:  return sf::Color::Black;
+	case GOLD:  return GLD;
+	case DEF:
+	default:    return cDefault;
+	}
+}
+
+//density of the specified material, in g/cm^3, from Wikipedia
+float get_material_density(Material mat)
+{
+	switch (mat)
+	{
+	case WOOD:  return 0.70f;
+	case STONE: return 2.00f;
+	case IRON:  return 7.87f;
+	case GOLD:  return 19.32f;
+	case DEF:
+	default:    return dDefault;
+	}
+}
+
+//returns the first time in [0, dt] at which a point starting at rel_pos and moving with rel_vel
+//comes within distance r of the origin, or -1 if it does not.
+//returns 0 if the point already lies inside and is moving inwards, and -1 if it is moving outwards
+float sweep_circle(const sf::Vector2f &rel_pos, const sf::Vector2f &rel_vel, float r, float dt)
+{
+	float a = dot(rel_vel, rel_vel);
+	float b = 2 * dot(rel_pos, rel_vel);
+	float c = dot(rel_pos, rel_pos) - r*r;
+
+	if (b >= 0) return -1;              //not approaching
+	if (c<0) return 0;
+
+	float disc = b*b - 4 * a*c;
+	if (disc<0) return -1;
+
+	float t = (-b - sqrt(disc)) / (2 * a);
+	if (t>dt) return -1;
+	return t<0 ? 0 : t;
+}
+
+//returns the first time in [0, dt] at which a ball of radius r starting at pos and moving with vel
+//touches the argument wall, or -1 if it does not. the ball is swept against the wall's rectangle
+//grown by r: its two faces, its two ends and a circle of radius r around each corner.
+//returns -1 if the ball already overlaps the wall; that case is left to bounce_off_wall
+float sweep_wall(const Wall &w, const sf::Vector2f &pos, const sf::Vector2f &vel, float r, float dt)
+{
+	sf::Vector2f p = w.relative_coordinates(pos);
+	sf::Vector2f v(dot(vel, w.get_tangent()), dot(vel, w.get_normal()));
+	float len = w.get_length();
+	float th = w.get_thickness();
+	float best = -1;
+	float t, x, y;
+
+	//already overlapping
+	if (p.y>-th - r && p.y<th + r && p.x>-r && p.x<len + r)
+	{
+		if ((p.x >= 0 && p.x <= len) || (p.y >= -th && p.y <= th)) return -1;
+		if (distance(p, sf::Vector2f(p.x<0 ? 0 : len, p.y<0 ? -th : th))<r) return -1;
+	}
+
+	//faces
+	if (v.y != 0)
+	{
+		y = v.y>0 ? -th - r : th + r;
+		t = (y - p.y) / v.y;
+		x = p.x + v.x*t;
+		if (t >= 0 && t <= dt && x >= 0 && x <= len) best = t;
+	}
+
+	//ends
+	if (v.x != 0)
+	{
+		x = v.x>0 ? -r : len + r;
+		t = (x - p.x) / v.x;
+		y = p.y + v.y*t;
+		if (t >= 0 && t <= dt && y >= -th && y <= th && (best<0 || t<best)) best = t;
+	}
+
+	//corners
+	const sf::Vector2f corners[4] = { sf::Vector2f(0, -th), sf::Vector2f(0, th), sf::Vector2f(len, -th), sf::Vector2f(len, th) };
+	for (int k = 0; k<4; k++)
+	{
+		t = sweep_circle(p - corners[k], v, r, dt);
+		if (t >= 0 && (best<0 || t<best)) best = t;
+	}
+
+	return best;
+}
+
+//returns the first time in [0, dt] at which a ball of radius r starting at pos and moving with vel
+//touches a side of the argument rectangle from the inside, or -1 if it does not.
+//x_side is set to true if the side hit is a left or right one (so the x-velocity should flip).
+//balls already past a side are left to the regular border bounce
+float sweep_border(const sf::FloatRect &area, const sf::Vector2f &pos, const sf::Vector2f &vel, float r, float dt, bool &x_side)
+{
+	float tx = -1, ty = -1;
+
+	if (vel.x<0 && pos.x >= area.left + r) tx = (area.left + r - pos.x) / vel.x;
+	if (vel.x>0 && pos.x <= area.left + area.width - r) tx = (area.left + area.width - r - pos.x) / vel.x;
+	if (vel.y<0 && pos.y >= area.top + r) ty = (area.top + r - pos.y) / vel.y;
+	if (vel.y>0 && pos.y <= area.top + area.height - r) ty = (area.top + area.height - r - pos.y) / vel.y;
+
+	if (tx>dt) tx = -1;
+	if (ty>dt) ty = -1;
+
+	x_side = tx >= 0 && (ty<0 || tx <= ty);
+	return x_side ? tx : ty;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 //Default Wall constructor
@@ -100,6 +218,14 @@ Wall::Wall(sf::Vector2f p1, sf::Vector2f p2, float th, sf::Color c)
 
 	fill_color = c;
 
+	velocity = sf::Vector2f(0, 0);
+	spin = 0;
+	pivot = 0.5f;
+
+	step_angle = 0;
+	step_cos = 1;
+	step_sin = 0;
+
 	update_vectors();
 }
 
@@ -118,13 +244,18 @@ Wall::Wall(sf::Vector2f p1, sf::Vector2f p2, const Wall& w)
 //keeps the length and thickness vectors of wall updated.
 //must be called any time the endpoints of the wall are altered.
 //v_l points from pt1 to pt2 (along the length of the wall), and
-//v_th points from pt1 to a corner (along the thickness/half the width of the wall)
+//v_th points from pt1 to a corner (along the thickness/half the width of the wall).
+//also caches the length and the unit frame (u_l, u_th), so collision code needs no sqrt or trig
 void Wall::update_vectors()
 {
 	v_l = pt2 - pt1;
+	length = magnitude(v_l);
 
-	v_th = sf::Vector2f(0, thickness);
-	if (magnitude(v_l)>0) set_vector_angle(v_th, angle(v_l) + 90);
+	if (length>0) u_l = v_l / length;
+	else u_l = sf::Vector2f(1, 0);
+
+	u_th = sf::Vector2f(-u_l.y, u_l.x);             //angle(v_l) + 90
+	v_th = thickness * u_th;
 }
 
 //returns a RectangleShape object which can be drawn
@@ -139,6 +270,17 @@ sf::RectangleShape Wall::get_rectangleShape() const
 	return rect;
 }
 
+//returns the velocity of the point pt, taken as rigidly attached to this wall.
+//zero everywhere for a wall that is not kinematic
+sf::Vector2f Wall::get_surface_velocity(const sf::Vector2f &pt) const
+{
+	if (spin == 0) return velocity;
+
+	sf::Vector2f r = pt - get_pivot_point();
+	float w = spin * PI / 180;
+	return velocity + w * sf::Vector2f(-r.y, r.x);
+}
+
 //sets the endpoints of this wall to the specified points and updates v_l and v_th accordingly
 void Wall::set_points(sf::Vector2f p1, sf::Vector2f p2)
 {
@@ -156,7 +298,7 @@ void Wall::set_thickness(float th)
 	else if (th == 0) thickness = thDefault;
 	else thickness = th;
 
-	set_magnitude(v_th, thickness);
+	v_th = thickness * u_th;
 }
 
 //returns the coordinates of the specified point if the wall were re-oriented so pt1 sits
@@ -165,7 +307,7 @@ void Wall::set_thickness(float th)
 sf::Vector2f Wall::relative_coordinates(const sf::Vector2f &pt) const
 {
 	sf::Vector2f rel = pt - pt1;
-	return sf::Vector2f(dot(rel, v_l) / magnitude(v_l), dot(rel, v_th) / thickness);
+	return sf::Vector2f(dot(rel, u_l), dot(rel, u_th));
 }
 
 //returns true if the specified point lies in the interior of this wall; false otherwise
@@ -194,6 +336,34 @@ sf::Vector2f Wall::nearest_corner(const sf::Vector2f &rel_pt) const
 	//call nearest_corner(relative_coordinates(pt));
 }
 
+//moves this wall rigidly by its velocity and spin over dt seconds.
+//the unit frame is turned by a rotation whose cosine and sine are only recomputed when spin * dt
+//changes, so a wall moving at a steady rate costs no trig or sqrt per step; the length is kept as is
+void Wall::move(float dt)
+{
+	sf::Vector2f c = get_pivot_point() + dt * velocity;
+
+	if (spin != 0)
+	{
+		float a = spin * dt;
+		if (a != step_angle)
+		{
+			step_angle = a;
+			step_cos = cos(a * PI / 180);
+			step_sin = sin(a * PI / 180);
+		}
+
+		u_l = sf::Vector2f(step_cos * u_l.x - step_sin * u_l.y, step_sin * u_l.x + step_cos * u_l.y);
+		u_l *= (3 - dot(u_l, u_l)) / 2;                 //undoes the rounding drift of repeated rotations
+		u_th = sf::Vector2f(-u_l.y, u_l.x);
+		v_l = length * u_l;
+		v_th = thickness * u_th;
+	}
+
+	pt1 = c - pivot * v_l;
+	pt2 = pt1 + v_l;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 //Default Ball constructor
@@ -243,31 +413,7 @@ Ball::Ball(sf::Vector2f pos, sf::Vector2f vel, float r, sf::Color c, float dens)
 //Constructor
 Ball::Ball(sf::Vector2f pos, sf::Vector2f vel, float r, Material mat)
 {
-	//densities are in g/cm^3, from Wikipedia
-
-	switch (mat)
-	{
-	case WOOD:
-		*this = Ball(pos, vel, r, TAN, 0.70);
-		break;
-
-	case STONE:
-		*this = Ball(pos, vel, r, GRAY, 2.00);
-		break;
-
-	case IRON:
-		*this = Ball(pos, vel, r, sf::Color::Black, 7.87);
-		break;
-
-	case GOLD:
-		*this = Ball(pos, vel, r, GLD, 19.32);
-		break;
-
-	case DEF:
-	default:
-		*this = Ball(pos, vel, r, cDefault, dDefault);
-		break;
-	}
+	*this = Ball(pos, vel, r, get_material_color(mat), get_material_density(mat));
 }
 
 //Constructor
@@ -409,6 +555,7 @@ void Ball::set_angle(float ang)
 //if the balls touch at exactly one point, it is not considered a collision
 bool Ball::is_colliding_with(const Ball &b) const
 {
+	PROFILE_COUNT(PAIR_TESTS, 1);
 	if (distance(position, b.position) - (radius + b.radius) < 0) return true;
 	return false;
 }
@@ -441,19 +588,40 @@ bool Ball::is_colliding_with(const Wall &w) const
 	return false;
 }
 
+//returns the time in [0, dt] at which this ball first touches the argument ball, assuming both keep
+//their current velocities, or -1 if they do not touch within dt.
+//returns 0 if the balls already overlap and are moving towards each other
+float Ball::time_of_impact(const Ball &b, float dt) const
+{
+	return sweep_circle(b.position - position, b.velocity - velocity, radius + b.radius, dt);
+}
+
+//returns the time in [0, dt] at which this ball first touches the argument wall, assuming it keeps
+//its current velocity, or -1 if it does not touch it within dt or already overlaps it
+float Ball::time_of_impact(const Wall &w, float dt) const
+{
+	return sweep_wall(w, position, velocity, radius, dt);
+}
+
 //bounces against a wall *perpendicular* to the argument angle
 //a vertical wall (horizontal bounce) is represented by angle 0 or 180
 void Ball::bounce(float ang)
 {
-	float alpha = get_angle();
-	float beta = ang + 90;            //parallel to wall
+	reflect(sf::Vector2f(cos(ang*PI / 180), sin(ang*PI / 180)));
+}
 
-	set_angle(2 * beta - alpha);
+//bounces against a surface with the argument *unit* normal, preserving speed.
+//equivalent to bounce(angle(n)) without any trig
+void Ball::reflect(const sf::Vector2f &n)
+{
+	velocity -= 2 * dot(velocity, n) * n;
 }
 
 //alters this ball's velocity to account for bouncing off the argument wall.
 //does not change the ball's velocity if it does not collide with the wall
 //(so ball/wall collision does not need to be checked first).
+//a kinematic wall is treated as infinitely heavy: the velocity relative to the wall's surface under the
+//ball's centre is reflected, which has the same normal part as at the contact point.
 //uses stutter protection if STUTTER_PROTECTION is set to true
 void Ball::bounce_off_wall(const Wall &w)
 {
@@ -463,29 +631,47 @@ void Ball::bounce_off_wall(const Wall &w)
 	if (coords.y <= -w.get_thickness() - radius || coords.y >= w.get_thickness() + radius) return;
 	if (coords.x <= -radius || coords.x >= w.get_length() + radius) return;
 
+	sf::Vector2f surface = w.get_surface_velocity(position);
+	velocity -= surface;
+
 	if (coords.x >= 0 && coords.x <= w.get_length())                     //bounces off main length of wall
 	{
-		if (!STUTTER_PROTECTION || dot(velocity, w.get_thick_vector()) * coords.y <= 0)
-			bounce(angle(w.get_thick_vector()));
+		if (!STUTTER_PROTECTION || dot(velocity, w.get_normal()) * coords.y <= 0)
+		{
+			reflect(w.get_normal());
+			PROFILE_COUNT(WALL_FACE_BOUNCES, 1);
+		}
+		else PROFILE_COUNT(STUTTER_REJECTS, 1);
 	}
 	else
 	{
 		if (coords.y >= -w.get_thickness() && coords.y <= w.get_thickness())     //bounces off edge of wall
 		{
-			if (!STUTTER_PROTECTION || dot(velocity, w.get_length_vector()) * coords.x <= 0)
-				bounce(angle(w.get_length_vector()));
+			if (!STUTTER_PROTECTION || dot(velocity, w.get_tangent()) * coords.x <= 0)
+			{
+				reflect(w.get_tangent());
+				PROFILE_COUNT(WALL_EDGE_BOUNCES, 1);
+			}
+			else PROFILE_COUNT(STUTTER_REJECTS, 1);
 		}
 		else
 		{
-			sf::Vector2f corner = w.nearest_corner(coords);
+			sf::Vector2f d = position - w.nearest_corner(coords);
+			float dist2 = dot(d, d);
 
-			if (distance(position, corner)<radius)                      //bounces off corner of wall
+			if (dist2<radius*radius && dist2>0)                         //bounces off corner of wall
 			{
-				if (!STUTTER_PROTECTION || dot(velocity, position - corner) <= 0)
-					bounce(angle(position - corner));
+				if (!STUTTER_PROTECTION || dot(velocity, d) <= 0)
+				{
+					reflect(d / sqrt(dist2));
+					PROFILE_COUNT(WALL_CORNER_BOUNCES, 1);
+				}
+				else PROFILE_COUNT(STUTTER_REJECTS, 1);
 			}
 		}
 	}
+
+	velocity += surface;
 }
 
 //updates the ball's position to account for the specified time passing.
@@ -522,6 +708,7 @@ void collide(Ball &ball1, Ball &ball2)
 			ball2.velocity = v2 - 2 * m / (m + n)*pr;
 			//formulas from Wikipedia - Elastic Collision
 		}
+		else PROFILE_COUNT(STUTTER_REJECTS, 1);
 	}
 }
 
@@ -21,6 +21,9 @@ const sf::Color wcDefault = sf::Color::Cyan;            //default wall color
 
 enum Material { WOOD, STONE, IRON, GOLD, DEF };           //material determines color and density of ball
 
+sf::Color get_material_color(Material mat);
+float get_material_density(Material mat);
+
 //Vector operations (possibly move to static class)
 float magnitude(const sf::Vector2f &v);
 float distance(const sf::Vector2f &v, const sf::Vector2f &w);
@@ -30,6 +33,15 @@ void set_magnitude(sf::Vector2f &v, float len);
 void set_vector_angle(sf::Vector2f &v, float ang);
 sf::Vector2f proj(const sf::Vector2f &v, const sf::Vector2f &w);
 
+class Wall;
+
+//Continuous collision detection (return a time in [0, dt], or -1 if there is no impact)
+const float CONTACT_SLOP = 0.01f;           //callers sweep with radii this much smaller, so a ball moved to its
+											//time of impact overlaps slightly and is_colliding_with sees the contact
+float sweep_circle(const sf::Vector2f &rel_pos, const sf::Vector2f &rel_vel, float r, float dt);
+float sweep_wall(const Wall &w, const sf::Vector2f &pos, const sf::Vector2f &vel, float r, float dt);
+float sweep_border(const sf::FloatRect &area, const sf::Vector2f &pos, const sf::Vector2f &vel, float r, float dt, bool &x_side);
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Wall
@@ -46,6 +58,18 @@ private:
 	sf::Vector2f v_l;            //points from pt1 to pt2
 	sf::Vector2f v_th;           //nonzero, points from pt1 to corner
 
+	float length;               //magnitude of v_l
+	sf::Vector2f u_l;            //unit vector along v_l, (1, 0) for a wall of zero length
+	sf::Vector2f u_th;           //unit vector along v_th, i.e. u_l turned 90 degrees
+
+	sf::Vector2f velocity;       //of the pivot, in pixels per second
+	float spin;                 //angular velocity about the pivot, in degrees per second
+	float pivot;                //fraction of the way from pt1 to pt2 the wall turns about
+
+	float step_angle;           //last angle move() turned by, and its cosine and sine
+	float step_cos;
+	float step_sin;
+
 	void update_vectors();
 
 public:
@@ -59,23 +83,36 @@ public:
 	//Wall(sf::Vector2f p1, float len, float ang, float th, sf::Color c);
 
 	//Getters
-	float get_length() const                   { return magnitude(v_l); }
+	float get_length() const                   { return length; }
 	float get_thickness() const                { return thickness; }
 	sf::Vector2f get_pt1() const               { return pt1; }
 	sf::Vector2f get_pt2() const               { return pt2; }
 	sf::Vector2f get_length_vector() const     { return v_l; }
 	sf::Vector2f get_thick_vector() const      { return v_th; }
+	sf::Vector2f get_tangent() const           { return u_l; }
+	sf::Vector2f get_normal() const            { return u_th; }
+	sf::Color get_color() const                { return fill_color; }
+	sf::Vector2f get_velocity() const          { return velocity; }
+	float get_spin() const                     { return spin; }
+	float get_pivot() const                    { return pivot; }
+	sf::Vector2f get_pivot_point() const       { return pt1 + pivot * v_l; }
+	bool is_kinematic() const                  { return spin != 0 || velocity.x != 0 || velocity.y != 0; }
 
 	sf::RectangleShape get_rectangleShape() const;
+	sf::Vector2f get_surface_velocity(const sf::Vector2f &pt) const;
 
 	//Setters
 	void set_points(sf::Vector2f p1, sf::Vector2f p2);
 	void set_thickness(float th);
+	void set_velocity(sf::Vector2f v)          { velocity = v; }
+	void set_spin(float w)                     { spin = w; }
+	void set_pivot(float t)                    { pivot = t; }
 
 	//Other functions
 	sf::Vector2f relative_coordinates(const sf::Vector2f &pt) const;
 	bool contains(const sf::Vector2f &pt) const;
 	sf::Vector2f nearest_corner(const sf::Vector2f &rel_pt) const;
+	void move(float dt);
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -119,6 +156,8 @@ public:
 	sf::Vector2f get_position() const       { return position; }
 	sf::Vector2f get_velocity() const       { return velocity; }
 	float get_radius() const                { return radius; }
+	float get_density() const               { return density; }
+	sf::Color get_color() const             { return fill_color; }
 
 	float get_speed() const;
 	float get_angle() const;
@@ -138,13 +177,19 @@ public:
 	bool is_colliding_with(const sf::Vector2f &point) const;
 	bool is_colliding_with(const Wall &w) const;
 
+	float time_of_impact(const Ball &b, float dt) const;
+	float time_of_impact(const Wall &w, float dt) const;
+
 	void bounce(float ang);
+	void reflect(const sf::Vector2f &n);
 	void bounce_off_wall(const Wall &w);
 
 	virtual void update_position(sf::Time dT);
 
 	friend void collide(Ball &ball1, Ball &ball2);
 	friend void collide(Ball &b, Wall &w);
+	friend class BallSystem;
+	friend class VirtualBalls;
 };
 
 int handle_error(int err_code);
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "BallKind.h"
+
+//Default Drag constructor - no drag
+Drag::Drag()
+{
+	rate = 0;
+}
+
+//Constructor
+Drag::Drag(float k)
+{
+	rate = 0;
+	set_rate(k);
+}
+
+//Default Thrust constructor - no thrust
+Thrust::Thrust()
+{
+	acceleration = 0;
+}
+
+//Constructor
+Thrust::Thrust(float a)
+{
+	acceleration = a;
+}
+
+//adds the ball with the argument id as a plain Ball, whose update_position only moves it
+void VirtualBalls::add(int id)
+{
+	add(id, std::unique_ptr<Ball>(new Ball()));
+}
+
+//adds the ball with the argument id, updated through the argument object from now on
+void VirtualBalls::add(int id, std::unique_ptr<Ball> b)
+{
+	ids.push_back(id);
+	objects.push_back(std::move(b));
+}
+
+void VirtualBalls::clear()
+{
+	ids.clear();
+	objects.clear();
+}
+
+//runs update_position of the objects of entries first .. last - 1 on the state of their balls.
+//the state is copied in and out directly, so MAX_SPEED is not applied to speeds the system already has
+void VirtualBalls::update(BallSystem &balls, int first, int last, float dt, const unsigned char *frozen)
+{
+	const int *index = balls.get_indices();
+	int k;
+
+	for (k = first; k<last; k++)
+	{
+		int i = index[ids[k]];
+		if (frozen && frozen[i]) continue;
+
+		Ball &b = *objects[k];
+		b.position = balls.get_position(i);
+		b.velocity = balls.get_velocity(i);
+		b.update_position(sf::seconds(dt));
+
+		balls.set_position(i, b.position - b.velocity * dt);
+		balls.set_velocity(i, b.velocity);
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "ball.h"
+#include "BallSystem.h"
+
+//a set of balls that share a behaviour, such as drag or thrust, applied once per step before they move.
+//balls are listed by id, so the list survives reordering of the BallSystem. World keeps one batch per
+//behaviour and calls update() on each every step, so there is one virtual call per batch rather than
+//one per ball; the loop over the balls is in the batch, where the behaviour's type is known.
+//new behaviours derive from BallKind (below), which writes that loop for them
+class BallBatch
+{
+protected:
+	std::vector<int> ids;
+
+public:
+	//Constructors
+	virtual ~BallBatch() {}
+
+	//Getters
+	int size() const                            { return (int)ids.size(); }
+	int get_id(int k) const                     { return ids[k]; }
+
+	//Other functions
+	virtual void add(int id)                    { ids.push_back(id); }
+	virtual void clear()                        { ids.clear(); }
+	virtual void update(BallSystem &balls, int first, int last, float dt, const unsigned char *frozen) = 0;
+};
+
+//base of a behaviour known at compile time. Kind derives from BallKind<Kind> and defines
+//	void update_ball(sf::Vector2f &pos, sf::Vector2f &vel, float dt) const;
+//which is called for entries first .. last - 1 of the batch, skipping balls marked in frozen (which may
+//be null). the call is resolved statically, so it is inlined into the loop. a behaviour should only
+//change the velocity; a changed position is a jump, which collisions do not see on the way
+template <class Kind>
+class BallKind : public BallBatch
+{
+public:
+	//Other functions
+	void update(BallSystem &balls, int first, int last, float dt, const unsigned char *frozen)
+	{
+		const Kind &kind = static_cast<const Kind &>(*this);
+		const int *index = balls.get_indices();
+
+		for (int k = first; k<last; k++)
+		{
+			int i = index[ids[k]];
+			if (frozen && frozen[i]) continue;
+
+			sf::Vector2f pos = balls.get_position(i);
+			sf::Vector2f vel = balls.get_velocity(i);
+			kind.update_ball(pos, vel, dt);
+			balls.set_position(i, pos);
+			balls.set_velocity(i, vel);
+		}
+	}
+};
+
+//loses velocity in proportion to speed: dv/dt = -rate * v, stepped implicitly so it never reverses a ball
+class Drag : public BallKind<Drag>
+{
+private:
+	float rate;                 //per second, >= 0
+
+public:
+	//Constructors
+	Drag();
+	Drag(float k);
+
+	//Getters
+	float get_rate() const                      { return rate; }
+
+	//Setters
+	void set_rate(float k)                      { rate = k<0 ? -k : k; }
+
+	//Other functions
+	void update_ball(sf::Vector2f &, sf::Vector2f &vel, float dt) const
+	{
+		vel *= 1 / (1 + rate * dt);
+	}
+};
+
+//accelerates balls along their direction of motion, up to MAX_SPEED; balls at rest are left at rest.
+//a negative acceleration brakes, stopping at zero speed rather than turning the ball around
+class Thrust : public BallKind<Thrust>
+{
+private:
+	float acceleration;         //pixels per second^2
+
+public:
+	//Constructors
+	Thrust();
+	Thrust(float a);
+
+	//Getters
+	float get_acceleration() const              { return acceleration; }
+
+	//Setters
+	void set_acceleration(float a)              { acceleration = a; }
+
+	//Other functions
+	void update_ball(sf::Vector2f &, sf::Vector2f &vel, float dt) const
+	{
+		float spd = sqrt(vel.x*vel.x + vel.y*vel.y);
+		if (spd == 0) return;
+
+		float next = spd + acceleration * dt;
+		if (next<0) next = 0;
+		if (next>MAX_SPEED) next = spd>MAX_SPEED ? spd : MAX_SPEED;
+		vel *= next / spd;
+	}
+};
+
+//compatibility path for subclasses of Ball that override the virtual Ball::update_position.
+//each ball keeps its object; update() loads the ball's state into it, calls update_position, and stores
+//the velocity back. the position is stored one step's travel behind where update_position put it, so
+//moving the balls at their new velocity lands them there. one indirect call per ball per step
+class VirtualBalls : public BallBatch
+{
+private:
+	std::vector<std::unique_ptr<Ball> > objects;
+
+public:
+	//Getters
+	const Ball &get_ball(int k) const           { return *objects[k]; }
+
+	//Other functions
+	void add(int id);
+	void add(int id, std::unique_ptr<Ball> b);
+	void clear();
+	void update(BallSystem &balls, int first, int last, float dt, const unsigned char *frozen);
+};
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include "BallSystem.h"
+#include "Profiler.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BALL_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BALL_SSE2
+#endif
+
+//Default BallSystem constructor - no balls
+BallSystem::BallSystem()
+{
+	contact_step = 0;
+}
+
+//returns a Ball with the exact state of ball i.
+//speeds above MAX_SPEED reached through collisions are kept
+Ball BallSystem::get(int i) const
+{
+	Ball b(sf::Vector2f(px[i], py[i]), sf::Vector2f(0, 0), radius[i], fill_color[i], density[i]);
+	b.velocity = sf::Vector2f(vx[i], vy[i]);
+	return b;
+}
+
+//overwrites ball i with the state of the argument ball
+void BallSystem::set(int i, const Ball &b)
+{
+	px[i] = b.position.x;
+	py[i] = b.position.y;
+	vx[i] = b.velocity.x;
+	vy[i] = b.velocity.y;
+	radius[i] = b.radius;
+	inv_mass[i] = b.mass>0 ? 1 / b.mass : ZERO_MASS_INV;
+	density[i] = b.density;
+	fill_color[i] = b.fill_color;
+}
+
+void BallSystem::reserve(int n)
+{
+	px.reserve(n);
+	py.reserve(n);
+	vx.reserve(n);
+	vy.reserve(n);
+	radius.reserve(n);
+	inv_mass.reserve(n);
+	density.reserve(n);
+	fill_color.reserve(n);
+	ball_id.reserve(n);
+	id_index.reserve(n);
+}
+
+void BallSystem::clear()
+{
+	px.clear();
+	py.clear();
+	vx.clear();
+	vy.clear();
+	radius.clear();
+	inv_mass.clear();
+	density.clear();
+	fill_color.clear();
+	ball_id.clear();
+	id_index.clear();
+}
+
+//appends a copy of the argument ball and returns its index
+int BallSystem::add(const Ball &b)
+{
+	px.push_back(0);
+	py.push_back(0);
+	vx.push_back(0);
+	vy.push_back(0);
+	radius.push_back(0);
+	inv_mass.push_back(0);
+	density.push_back(0);
+	fill_color.push_back(b.fill_color);
+	ball_id.push_back(size() - 1);
+	id_index.push_back(size() - 1);
+
+	set(size() - 1, b);
+	return size() - 1;
+}
+
+//appends a ball without going through the Ball constructors and returns its index.
+//applies the same limits as the primary Ball constructor
+int BallSystem::add(sf::Vector2f pos, sf::Vector2f vel, float r, sf::Color c, float dens)
+{
+	if (r<0) r = -r;
+	if (r>MAX_RADIUS) r = MAX_RADIUS;
+	if (dens<0) dens = -dens;
+
+	float spd = magnitude(vel);
+	if (spd>MAX_SPEED) vel *= MAX_SPEED / spd;
+
+	float mass = dens * 4.0f / 3.0f * PI * r*r*r;
+
+	px.push_back(pos.x);
+	py.push_back(pos.y);
+	vx.push_back(vel.x);
+	vy.push_back(vel.y);
+	radius.push_back(r);
+	inv_mass.push_back(mass>0 ? 1 / mass : ZERO_MASS_INV);
+	density.push_back(dens);
+	fill_color.push_back(c);
+	ball_id.push_back(size() - 1);
+	id_index.push_back(size() - 1);
+
+	return size() - 1;
+}
+
+//appends n balls from arrays of positions (x, y), velocities (u, v), radii, densities and colors,
+//growing each array of the system once. applies the same limits as add(pos, vel, r, c, dens).
+//returns the index of the first new ball
+int BallSystem::add(const float *x, const float *y, const float *u, const float *v, const float *r, const float *dens,
+	const sf::Color *c, int n)
+{
+	int first = size();
+	int i;
+
+	px.insert(px.end(), x, x + n);
+	py.insert(py.end(), y, y + n);
+	vx.insert(vx.end(), u, u + n);
+	vy.insert(vy.end(), v, v + n);
+	radius.insert(radius.end(), r, r + n);
+	density.insert(density.end(), dens, dens + n);
+	fill_color.insert(fill_color.end(), c, c + n);
+	inv_mass.resize(first + n);
+	ball_id.resize(first + n);
+	id_index.resize(first + n);
+
+	for (i = first; i<first + n; i++)
+	{
+		ball_id[i] = i;
+		id_index[i] = i;
+
+		if (radius[i]<0) radius[i] = -radius[i];
+		if (radius[i]>MAX_RADIUS) radius[i] = MAX_RADIUS;
+		if (density[i]<0) density[i] = -density[i];
+
+		float spd2 = vx[i] * vx[i] + vy[i] * vy[i];
+		if (spd2>MAX_SPEED*MAX_SPEED)
+		{
+			float k = MAX_SPEED / sqrt(spd2);
+			vx[i] *= k;
+			vy[i] *= k;
+		}
+
+		float mass = density[i] * 4.0f / 3.0f * PI * radius[i] * radius[i] * radius[i];
+		inv_mass[i] = mass>0 ? 1 / mass : ZERO_MASS_INV;
+	}
+
+	return first;
+}
+
+//sets a[k] to a[order[k]] for every k, using scratch (left holding the old array)
+template <class T>
+static void reorder(std::vector<T> &a, const int *order, std::vector<T> &scratch)
+{
+	int k;
+
+	scratch.resize(a.size());
+	for (k = 0; k<(int)a.size(); k++)
+		scratch[k] = a[order[k]];
+	a.swap(scratch);
+}
+
+//moves ball order[k] to index k for every k. order must hold every index exactly once.
+//ids stay with their balls
+void BallSystem::permute(const int *order)
+{
+	std::vector<float> f;
+	std::vector<sf::Color> c;
+	std::vector<int> ids;
+	int k;
+
+	reorder(px, order, f);
+	reorder(py, order, f);
+	reorder(vx, order, f);
+	reorder(vy, order, f);
+	reorder(radius, order, f);
+	reorder(inv_mass, order, f);
+	reorder(density, order, f);
+	reorder(fill_color, order, c);
+	reorder(ball_id, order, ids);
+
+	for (k = 0; k<size(); k++)
+		id_index[ball_id[k]] = k;
+}
+
+//makes collide(), bounce_off_walls() and bounce_off_border() write a Contact to the argument stream for
+//every impact they resolve. must not be called while they run; with no streams, nothing is computed for
+//them. the stream is not owned, and a copy of this system writes to it too until it is removed there
+void BallSystem::add_stream(ContactStream *s)
+{
+	if (std::find(contact_streams.begin(), contact_streams.end(), s) == contact_streams.end())
+		contact_streams.push_back(s);
+}
+
+void BallSystem::remove_stream(ContactStream *s)
+{
+	contact_streams.erase(std::remove(contact_streams.begin(), contact_streams.end(), s), contact_streams.end());
+}
+
+//advances every ball by dt seconds. equivalent to Ball::update_position on each ball
+void BallSystem::integrate(float dt)
+{
+	integrate(dt, 0, size());
+}
+
+//advances balls first .. last - 1 by dt seconds
+void BallSystem::integrate(float dt, int first, int last)
+{
+	int n = last;
+	int i = first;
+	float *x = size() ? &px[0] : 0;
+	float *y = size() ? &py[0] : 0;
+	const float *u = size() ? &vx[0] : 0;
+	const float *v = size() ? &vy[0] : 0;
+
+#if defined(BALL_AVX2)
+	__m256 t8 = _mm256_set1_ps(dt);
+	for (; i + 8 <= n; i += 8)
+	{
+		_mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(u + i), t8)));
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(v + i), t8)));
+	}
+#endif
+#if defined(BALL_SSE2)
+	__m128 t4 = _mm_set1_ps(dt);
+	for (; i + 4 <= n; i += 4)
+	{
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(u + i), t4)));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(v + i), t4)));
+	}
+#endif
+	for (; i<n; i++)
+	{
+		x[i] += u[i] * dt;
+		y[i] += v[i] * dt;
+	}
+}
+
+//advances balls which[0] .. which[n - 1] by dt seconds, leaving the others where they are
+void BallSystem::integrate(float dt, const int *which, int n)
+{
+	int k;
+
+	for (k = 0; k<n; k++)
+	{
+		int i = which[k];
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+	}
+}
+
+//reverses the velocity component of every ball that is touching a side of the argument
+//rectangle and moving out of it, the same way main.cpp bounces balls off the window border.
+//each reversal is a WALL_CONTACT with BORDER_INDEX for the streams
+void BallSystem::bounce_off_border(sf::FloatRect area)
+{
+	bounce_off_border(area, 0, size());
+}
+
+//bounce_off_border for balls first .. last - 1 only
+void BallSystem::bounce_off_border(sf::FloatRect area, int first, int last)
+{
+	int n = last;
+	int i = first;
+	float left = area.left;
+	float top = area.top;
+	float right = area.left + area.width;
+	float bottom = area.top + area.height;
+	const float *x = size() ? &px[0] : 0;
+	const float *y = size() ? &py[0] : 0;
+	const float *r = size() ? &radius[0] : 0;
+	float *u = size() ? &vx[0] : 0;
+	float *v = size() ? &vy[0] : 0;
+
+#if defined(BALL_SSE2)
+	//with streams, the scalar loop below does every ball so that it can write the contacts
+	__m128 zero = _mm_setzero_ps();
+	__m128 sign = _mm_set1_ps(-0.0f);
+	__m128 l4 = _mm_set1_ps(left);
+	__m128 t4 = _mm_set1_ps(top);
+	__m128 r4 = _mm_set1_ps(right);
+	__m128 b4 = _mm_set1_ps(bottom);
+	for (; contact_streams.empty() && i + 4 <= n; i += 4)
+	{
+		__m128 rad = _mm_loadu_ps(r + i);
+		__m128 xi = _mm_loadu_ps(x + i);
+		__m128 yi = _mm_loadu_ps(y + i);
+		__m128 ui = _mm_loadu_ps(u + i);
+		__m128 vi = _mm_loadu_ps(v + i);
+
+		//flip the sign bit of the lanes that hit a side while moving towards it
+		__m128 hitx = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(xi, _mm_add_ps(l4, rad)), _mm_cmplt_ps(ui, zero)),
+			_mm_and_ps(_mm_cmpgt_ps(xi, _mm_sub_ps(r4, rad)), _mm_cmpgt_ps(ui, zero)));
+		__m128 hity = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(yi, _mm_add_ps(t4, rad)), _mm_cmplt_ps(vi, zero)),
+			_mm_and_ps(_mm_cmpgt_ps(yi, _mm_sub_ps(b4, rad)), _mm_cmpgt_ps(vi, zero)));
+
+		_mm_storeu_ps(u + i, _mm_xor_ps(ui, _mm_and_ps(hitx, sign)));
+		_mm_storeu_ps(v + i, _mm_xor_ps(vi, _mm_and_ps(hity, sign)));
+	}
+#endif
+	for (; i<n; i++)
+	{
+		if ((x[i]<left + r[i] && u[i]<0) || (x[i]>right - r[i] && u[i]>0))
+		{
+			if (!contact_streams.empty()) emit_border_contact(i, u[i]<0 ? left : right, y[i], u[i]<0 ? -u[i] : u[i]);
+			u[i] = -u[i];
+		}
+		if ((y[i]<top + r[i] && v[i]<0) || (y[i]>bottom - r[i] && v[i]>0))
+		{
+			if (!contact_streams.empty()) emit_border_contact(i, x[i], v[i]<0 ? top : bottom, v[i]<0 ? -v[i] : v[i]);
+			v[i] = -v[i];
+		}
+	}
+}
+
+//bounce_off_border for balls which[0] .. which[n - 1] only
+void BallSystem::bounce_off_border(sf::FloatRect area, const int *which, int n)
+{
+	float left = area.left;
+	float top = area.top;
+	float right = area.left + area.width;
+	float bottom = area.top + area.height;
+	int k;
+
+	for (k = 0; k<n; k++)
+	{
+		int i = which[k];
+		if ((px[i]<left + radius[i] && vx[i]<0) || (px[i]>right - radius[i] && vx[i]>0))
+		{
+			if (!contact_streams.empty()) emit_border_contact(i, vx[i]<0 ? left : right, py[i], vx[i]<0 ? -vx[i] : vx[i]);
+			vx[i] = -vx[i];
+		}
+		if ((py[i]<top + radius[i] && vy[i]<0) || (py[i]>bottom - radius[i] && vy[i]>0))
+		{
+			if (!contact_streams.empty()) emit_border_contact(i, px[i], vy[i]<0 ? top : bottom, vy[i]<0 ? -vy[i] : vy[i]);
+			vy[i] = -vy[i];
+		}
+	}
+}
+
+//reverses the x velocity of ball i, which has reached the left or right side of the argument rectangle,
+//and writes the contact as bounce_off_border does. for engines that find the moment of the bounce
+void BallSystem::bounce_off_border_x(int i, sf::FloatRect area)
+{
+	if (!contact_streams.empty()) emit_border_contact(i, vx[i]<0 ? area.left : area.left + area.width, py[i], vx[i]<0 ? -vx[i] : vx[i]);
+	vx[i] = -vx[i];
+}
+
+//bounce_off_border_x for the top or bottom side
+void BallSystem::bounce_off_border_y(int i, sf::FloatRect area)
+{
+	if (!contact_streams.empty()) emit_border_contact(i, px[i], vy[i]<0 ? area.top : area.top + area.height, vy[i]<0 ? -vy[i] : vy[i]);
+	vy[i] = -vy[i];
+}
+
+//for each of the n candidate pairs, sets hits[k] to 1 if the two balls overlap and 0 otherwise.
+//uses the same strict test as Ball::is_colliding_with(const Ball&), but on squared distances
+void BallSystem::test_overlaps(const CandidatePair *pairs, int n, unsigned char *hits) const
+{
+	int k = 0;
+	const float *x = size() ? &px[0] : 0;
+	const float *y = size() ? &py[0] : 0;
+	const float *r = size() ? &radius[0] : 0;
+
+	PROFILE_COUNT(PAIR_TESTS, n);
+
+#if defined(BALL_AVX2)
+	//CandidatePair is two ints, so the a and b indices of 8 pairs are gathered with a stride of 2
+	__m256i stride = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	for (; k + 8 <= n; k += 8)
+	{
+		const int *base = &pairs[k].a;
+		__m256i ia = _mm256_i32gather_epi32(base, stride, 4);
+		__m256i ib = _mm256_i32gather_epi32(base + 1, stride, 4);
+
+		__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(x, ia, 4), _mm256_i32gather_ps(x, ib, 4));
+		__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(y, ia, 4), _mm256_i32gather_ps(y, ib, 4));
+		__m256 rr = _mm256_add_ps(_mm256_i32gather_ps(r, ia, 4), _mm256_i32gather_ps(r, ib, 4));
+
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(rr, rr), _CMP_LT_OQ));
+
+		for (int l = 0; l<8; l++)
+			hits[k + l] = (mask >> l) & 1;
+	}
+#elif defined(BALL_SSE2)
+	for (; k + 4 <= n; k += 4)
+	{
+		const CandidatePair *p = pairs + k;
+		__m128 dx = _mm_sub_ps(_mm_setr_ps(x[p[0].a], x[p[1].a], x[p[2].a], x[p[3].a]),
+			_mm_setr_ps(x[p[0].b], x[p[1].b], x[p[2].b], x[p[3].b]));
+		__m128 dy = _mm_sub_ps(_mm_setr_ps(y[p[0].a], y[p[1].a], y[p[2].a], y[p[3].a]),
+			_mm_setr_ps(y[p[0].b], y[p[1].b], y[p[2].b], y[p[3].b]));
+		__m128 rr = _mm_add_ps(_mm_setr_ps(r[p[0].a], r[p[1].a], r[p[2].a], r[p[3].a]),
+			_mm_setr_ps(r[p[0].b], r[p[1].b], r[p[2].b], r[p[3].b]));
+
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(d2, _mm_mul_ps(rr, rr)));
+
+		for (int l = 0; l<4; l++)
+			hits[k + l] = (mask >> l) & 1;
+	}
+#endif
+	for (; k<n; k++)
+	{
+		float dx = x[pairs[k].a] - x[pairs[k].b];
+		float dy = y[pairs[k].a] - y[pairs[k].b];
+		float rr = r[pairs[k].a] + r[pairs[k].b];
+		hits[k] = dx*dx + dy*dy < rr*rr;
+	}
+}
+
+//tests the n candidate pairs for overlap and collides the ones that overlap, in order.
+//hits is scratch space for n results, owned by the caller so that no step allocates
+void BallSystem::collide(const CandidatePair *pairs, int n, unsigned char *hits)
+{
+	int k;
+
+	if (n == 0) return;
+	test_overlaps(pairs, n, hits);
+
+	for (k = 0; k<n; k++)
+	{
+		if (hits[k])
+		{
+			PROFILE_COUNT(OVERLAPS, 1);
+			collide(pairs[k].a, pairs[k].b);
+		}
+	}
+}
+
+//alters the velocities of balls i and j exactly like collide(Ball&, Ball&), written in terms
+//of inverse masses. returns true if the velocities were changed.
+//***Does not check whether the balls are actually colliding***
+bool BallSystem::collide(int i, int j)
+{
+	float dx = px[j] - px[i];
+	float dy = py[j] - py[i];
+	float du = vx[j] - vx[i];
+	float dv = vy[j] - vy[i];
+
+	if (dx == 0 && dy == 0) return false;
+
+	float dvx = du*dx + dv*dy;
+	if (STUTTER_PROTECTION && dvx >= 0)
+	{
+		PROFILE_COUNT(STUTTER_REJECTS, 1);
+		return false;
+	}
+
+	if (!contact_streams.empty())
+	{
+		//the point dividing the centres in the ratio of the radii, so the surfaces meet there when touching
+		float d = sqrt(dx*dx + dy*dy);
+		float f = radius[i] + radius[j]>0 ? radius[i] / (radius[i] + radius[j]) : 0.5f;
+		Contact c = { contact_step, ball_id[i], ball_id[j], BALL_CONTACT, px[i] + f * dx, py[i] + f * dy, -dvx / d };
+		int k;
+
+		for (k = 0; k<(int)contact_streams.size(); k++)
+			contact_streams[k]->push(c);
+	}
+
+	float s = dvx / (dx*dx + dy*dy);                //pr = s * (dx, dy)
+	float m = inv_mass[i];
+	float n = inv_mass[j];
+	float ci = 2 * m / (m + n) * s;
+	float cj = 2 * n / (m + n) * s;
+
+	vx[i] += ci * dx;
+	vy[i] += ci * dy;
+	vx[j] -= cj * dx;
+	vy[j] -= cj * dy;
+	return true;
+}
+
+//bounces ball i off each of the n argument walls it is colliding with, in order
+void BallSystem::bounce_off_walls(int i, const Wall *ws, int n)
+{
+	Ball b = get(i);
+	int j;
+
+	for (j = 0; j<n; j++)
+	{
+		if (b.is_colliding_with(ws[j]))
+		{
+			sf::Vector2f before = b.velocity;
+			b.bounce_off_wall(ws[j]);
+			if (!contact_streams.empty()) emit_wall_contact(i, b, before, ws[j], j);
+		}
+	}
+
+	vx[i] = b.velocity.x;
+	vy[i] = b.velocity.y;
+}
+
+//bounces ball i off each of the walls ws[which[0]] .. ws[which[n - 1]] it is colliding with, in order
+void BallSystem::bounce_off_walls(int i, const Wall *ws, const int *which, int n)
+{
+	Ball b = get(i);
+	int j;
+
+	for (j = 0; j<n; j++)
+	{
+		if (b.is_colliding_with(ws[which[j]]))
+		{
+			sf::Vector2f before = b.velocity;
+			b.bounce_off_wall(ws[which[j]]);
+			if (!contact_streams.empty()) emit_wall_contact(i, b, before, ws[which[j]], which[j]);
+		}
+	}
+
+	vx[i] = b.velocity.x;
+	vy[i] = b.velocity.y;
+}
+
+//writes a contact between ball i, whose state after bouncing off wall number index is b, and the wall to
+//every stream. the wall reflects the approach speed, so the velocity changed by twice that speed;
+//nothing is written if it did not change. the contact point is the point of the wall nearest the centre
+void BallSystem::emit_wall_contact(int i, const Ball &b, sf::Vector2f before, const Wall &w, int index)
+{
+	sf::Vector2f dv = b.velocity - before;
+	if (dv.x == 0 && dv.y == 0) return;
+
+	sf::Vector2f p = w.relative_coordinates(b.position);
+	float along = p.x<0 ? 0 : p.x>w.get_length() ? w.get_length() : p.x;
+	float across = p.y<-w.get_thickness() ? -w.get_thickness() : p.y>w.get_thickness() ? w.get_thickness() : p.y;
+	sf::Vector2f pt = w.get_pt1() + along * w.get_tangent() + across * w.get_normal();
+	Contact c = { contact_step, ball_id[i], index, WALL_CONTACT, pt.x, pt.y, magnitude(dv) / 2 };
+	int k;
+
+	for (k = 0; k<(int)contact_streams.size(); k++)
+		contact_streams[k]->push(c);
+}
+
+//writes a contact between ball i and the border at point (x, y) to every stream. speed is the velocity
+//component across that side of the border, which the bounce reverses
+void BallSystem::emit_border_contact(int i, float x, float y, float speed)
+{
+	Contact c = { contact_step, ball_id[i], BORDER_INDEX, WALL_CONTACT, x, y, speed };
+	int k;
+
+	for (k = 0; k<(int)contact_streams.size(); k++)
+		contact_streams[k]->push(c);
+}
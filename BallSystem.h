@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include "ball.h"
+#include "Grid.h"
+#include "ContactStream.h"
+
+const float ZERO_MASS_INV = 1e30f;          //inverse mass used for balls of zero mass
+
+//structure-of-arrays storage for a large population of balls.
+//positions, velocities, radii and inverse masses live in separate contiguous arrays so the
+//per-step kernels below can run over them with SSE/AVX2 (scalar code is used when neither is available).
+//Ball remains the exchange type: get() and set() convert between a Ball and an index in the system,
+//and the narrow phase functions of Ball (bounce_off_wall etc.) can be run on the result.
+//indices change when the balls are reordered (see permute); every ball also has an id, its index when
+//it was added, which never changes, so handles to balls should be kept as ids
+class BallSystem
+{
+private:
+	std::vector<float> px;
+	std::vector<float> py;
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<float> radius;
+	std::vector<float> inv_mass;        //1/mass; balls with zero mass get ZERO_MASS_INV
+
+	std::vector<float> density;         //only needed to rebuild a Ball
+	std::vector<sf::Color> fill_color;
+
+	std::vector<int> ball_id;           //id of the ball at each index
+	std::vector<int> id_index;          //index of the ball with each id
+
+	std::vector<ContactStream *> contact_streams;   //receive every collision and wall or border bounce; usually none.
+	                                                //not owned: copies report to the same streams
+	long long contact_step;                         //step number written into contacts
+
+	void emit_wall_contact(int i, const Ball &b, sf::Vector2f before, const Wall &w, int index);
+	void emit_border_contact(int i, float x, float y, float speed);
+
+public:
+	//Constructors
+	BallSystem();
+
+	//Getters
+	int size() const                            { return (int)px.size(); }
+	sf::Vector2f get_position(int i) const      { return sf::Vector2f(px[i], py[i]); }
+	sf::Vector2f get_velocity(int i) const      { return sf::Vector2f(vx[i], vy[i]); }
+	float get_radius(int i) const               { return radius[i]; }
+	float get_inv_mass(int i) const             { return inv_mass[i]; }
+	float get_density(int i) const              { return density[i]; }
+	sf::Color get_color(int i) const            { return fill_color[i]; }
+	int get_id(int i) const                     { return ball_id[i]; }
+	int get_index(int id) const                 { return id_index[id]; }
+	const int *get_indices() const              { return id_index.empty() ? 0 : &id_index[0]; }
+	int get_num_streams() const                 { return (int)contact_streams.size(); }
+
+	const float *get_x() const                  { return px.empty() ? 0 : &px[0]; }
+	const float *get_y() const                  { return py.empty() ? 0 : &py[0]; }
+	const float *get_vx() const                 { return vx.empty() ? 0 : &vx[0]; }
+	const float *get_vy() const                 { return vy.empty() ? 0 : &vy[0]; }
+	const float *get_radii() const              { return radius.empty() ? 0 : &radius[0]; }
+
+	Ball get(int i) const;
+
+	//Setters
+	void set(int i, const Ball &b);
+	void set_position(int i, sf::Vector2f pos)  { px[i] = pos.x; py[i] = pos.y; }
+	void set_velocity(int i, sf::Vector2f vel)  { vx[i] = vel.x; vy[i] = vel.y; }
+	void set_contact_step(long long s)          { contact_step = s; }
+
+	//Other functions
+	void reserve(int n);
+	void clear();
+	int add(const Ball &b);
+	int add(sf::Vector2f pos, sf::Vector2f vel, float r, sf::Color c, float dens);
+	int add(const float *x, const float *y, const float *u, const float *v, const float *r, const float *dens,
+		const sf::Color *c, int n);
+
+	void permute(const int *order);
+	void add_stream(ContactStream *s);
+	void remove_stream(ContactStream *s);
+
+	void integrate(float dt);
+	void integrate(float dt, int first, int last);
+	void integrate(float dt, const int *which, int n);
+	void bounce_off_border(sf::FloatRect area);
+	void bounce_off_border(sf::FloatRect area, int first, int last);
+	void bounce_off_border(sf::FloatRect area, const int *which, int n);
+	void bounce_off_border_x(int i, sf::FloatRect area);
+	void bounce_off_border_y(int i, sf::FloatRect area);
+	void test_overlaps(const CandidatePair *pairs, int n, unsigned char *hits) const;
+	void collide(const CandidatePair *pairs, int n, unsigned char *hits);
+	bool collide(int i, int j);
+	void bounce_off_walls(int i, const Wall *ws, int n);
+	void bounce_off_walls(int i, const Wall *ws, const int *which, int n);
+};
@@ -0,0 +1,135 @@
+#include "BatchRenderer.h"
+
+//Default BatchRenderer constructor
+//generates the circle texture: white, with alpha falling off over the last pixel of the radius
+BatchRenderer::BatchRenderer()
+{
+	const int size = CIRCLE_TEXTURE_SIZE;
+	float r = size / 2.0f;
+	int x, y;
+
+	sf::Image img;
+	img.create(size, size, sf::Color::Transparent);
+
+	for (y = 0; y<size; y++)
+	{
+		for (x = 0; x<size; x++)
+		{
+			float d = distance(sf::Vector2f(x + 0.5f, y + 0.5f), sf::Vector2f(r, r));
+			float a = r - d;                //coverage of this pixel by the circle edge
+
+			if (a>1) a = 1;
+			if (a>0) img.setPixel(x, y, sf::Color(255, 255, 255, (sf::Uint8)(255 * a)));
+		}
+	}
+
+	circle.loadFromImage(img);
+	circle.setSmooth(true);
+
+	vertices.setPrimitiveType(sf::Triangles);
+}
+
+//writes quad number q (corners in winding order) into the vertex array.
+//textured quads map the corners onto the circle texture; untextured ones sample its opaque centre
+void BatchRenderer::write_quad(int q, sf::Vector2f p0, sf::Vector2f p1, sf::Vector2f p2, sf::Vector2f p3,
+	sf::Color c, bool textured)
+{
+	float s = (float)CIRCLE_TEXTURE_SIZE;
+	sf::Vertex *v = &vertices[6 * q];
+	sf::Vector2f t0(0, 0), t1(s, 0), t2(s, s), t3(0, s);
+
+	if (!textured) t0 = t1 = t2 = t3 = sf::Vector2f(s / 2, s / 2);
+
+	v[0] = sf::Vertex(p0, c, t0);
+	v[1] = sf::Vertex(p1, c, t1);
+	v[2] = sf::Vertex(p2, c, t2);
+	v[3] = sf::Vertex(p0, c, t0);
+	v[4] = sf::Vertex(p2, c, t2);
+	v[5] = sf::Vertex(p3, c, t3);
+}
+
+//rewrites the vertex array from the current state of the world
+void BatchRenderer::update(const World &world)
+{
+	update(world.get_balls(), world.get_walls(), world.get_num_walls());
+}
+
+//rewrites the vertex array from the argument balls and walls.
+//the array is only resized when the number of objects changes
+void BatchRenderer::update(const BallSystem &balls, const Wall *ws, int num_walls)
+{
+	int n = balls.size();
+	int i;
+
+	if ((int)vertices.getVertexCount() != 6 * (num_walls + n))
+		vertices.resize(6 * (num_walls + n));
+
+	//walls span pt1 to pt2 along their length and +-v_th across it
+	for (i = 0; i<num_walls; i++)
+	{
+		sf::Vector2f p1 = ws[i].get_pt1();
+		sf::Vector2f p2 = ws[i].get_pt2();
+		sf::Vector2f th = ws[i].get_thick_vector();
+
+		write_quad(i, p1 - th, p2 - th, p2 + th, p1 + th, ws[i].get_color(), false);
+	}
+
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	const float *r = balls.get_radii();
+	auto write_balls = [&](int begin, int end)
+	{
+		for (int i = begin; i<end; i++)
+		{
+			write_quad(num_walls + i, sf::Vector2f(x[i] - r[i], y[i] - r[i]), sf::Vector2f(x[i] + r[i], y[i] - r[i]),
+				sf::Vector2f(x[i] + r[i], y[i] + r[i]), sf::Vector2f(x[i] - r[i], y[i] + r[i]), balls.get_color(i), true);
+		}
+	};
+
+	if (pool) pool->parallel_for(n, write_balls);
+	else write_balls(0, n);
+}
+
+//rewrites the vertex array from a snapshot, with balls alpha of the way (0 to 1)
+//from their previous positions to their current ones
+void BatchRenderer::update(const Snapshot &s, float alpha)
+{
+	int num_walls = (int)s.walls.size();
+	int n = (int)s.x.size();
+	int i;
+
+	if ((int)vertices.getVertexCount() != 6 * (num_walls + n))
+		vertices.resize(6 * (num_walls + n));
+
+	for (i = 0; i<num_walls; i++)
+	{
+		sf::Vector2f p1 = s.walls[i].get_pt1();
+		sf::Vector2f p2 = s.walls[i].get_pt2();
+		sf::Vector2f th = s.walls[i].get_thick_vector();
+
+		write_quad(i, p1 - th, p2 - th, p2 + th, p1 + th, s.walls[i].get_color(), false);
+	}
+
+	auto write_balls = [&](int begin, int end)
+	{
+		for (int i = begin; i<end; i++)
+		{
+			float x = s.prev_x[i] + alpha * (s.x[i] - s.prev_x[i]);
+			float y = s.prev_y[i] + alpha * (s.y[i] - s.prev_y[i]);
+			float r = s.radius[i];
+
+			write_quad(num_walls + i, sf::Vector2f(x - r, y - r), sf::Vector2f(x + r, y - r),
+				sf::Vector2f(x + r, y + r), sf::Vector2f(x - r, y + r), s.color[i], true);
+		}
+	};
+
+	if (pool) pool->parallel_for(n, write_balls);
+	else write_balls(0, n);
+}
+
+//draws everything with one call
+void BatchRenderer::draw(sf::RenderTarget &target, sf::RenderStates states) const
+{
+	states.texture = &circle;
+	target.draw(vertices, states);
+}
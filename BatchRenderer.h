@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <SFML/Graphics.hpp>
+#include "ball.h"
+#include "BallSystem.h"
+#include "World.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+const int CIRCLE_TEXTURE_SIZE = 64;         //side of the generated circle texture, in pixels
+
+//draws every wall and ball of a world in a single draw call.
+//each ball is a textured quad cut out by an anti-aliased circle texture and tinted with the
+//ball's color; each wall is a quad sampling the opaque centre of the same texture.
+//the vertex array is kept between frames and only rewritten in place from current positions,
+//split across a thread pool if one is set
+class BatchRenderer : public sf::Drawable
+{
+private:
+	sf::Texture circle;
+	sf::VertexArray vertices;           //6 vertices (two triangles) per wall, then per ball
+	std::shared_ptr<ThreadPool> pool;   //may be shared with a World
+
+	void write_quad(int q, sf::Vector2f p0, sf::Vector2f p1, sf::Vector2f p2, sf::Vector2f p3,
+		sf::Color c, bool textured);
+
+	virtual void draw(sf::RenderTarget &target, sf::RenderStates states) const;
+
+public:
+	//Constructors
+	BatchRenderer();
+
+	//Getters
+	int get_vertex_count() const            { return (int)vertices.getVertexCount(); }
+
+	//Setters
+	void set_pool(const std::shared_ptr<ThreadPool> &p)     { pool = p; }
+
+	//Other functions
+	void update(const World &world);
+	void update(const BallSystem &balls, const Wall *ws, int num_walls);
+	void update(const Snapshot &s, float alpha);
+};
@@ -0,0 +1,517 @@
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+#include "ChunkedWorld.h"
+#include "WallRecord.h"
+
+//a cold tile is stored as a 32 bit wall count, that many WallRecords, then DomainBall records up to the
+//end, so a ball moving into a cold tile is appended without unpacking it. the records keep the walls'
+//motion, and their positions are those at the chunk's wall_step
+
+//Constructor - CHUNK_SIZE tiles
+ChunkedWorld::ChunkedWorld(sf::FloatRect area)
+{
+	whole = area;
+	set_layout(CHUNK_SIZE);
+}
+
+//Constructor
+ChunkedWorld::ChunkedWorld(sf::FloatRect area, float size)
+{
+	whole = area;
+	set_layout(size);
+}
+
+//allows only positive tile sizes
+void ChunkedWorld::set_layout(float size)
+{
+	chunk_size = size<0 ? -size : size;
+	if (chunk_size == 0) chunk_size = CHUNK_SIZE;
+	cols = (int)ceil(whole.width / chunk_size);
+	rows = (int)ceil(whole.height / chunk_size);
+	if (cols<1) cols = 1;
+	if (rows<1) rows = 1;
+
+	halo = DOMAIN_HALO;
+	max_radius = 0;
+	fixed_dt = FIXED_DT;
+	active_range = CHUNK_ACTIVE_RANGE;
+	cold_range = CHUNK_COLD_RANGE;
+	step_count = 0;
+	next_id = 0;
+	num_balls = 0;
+	num_restored = 0;
+	num_stored = 0;
+}
+
+//allows only positive timesteps; active tiles change theirs at once
+void ChunkedWorld::set_fixed_dt(float dt)
+{
+	size_t k;
+
+	if (dt<0) dt = -dt;
+	if (dt>0) fixed_dt = dt;
+	for (k = 0; k<active.size(); k++)
+		active[k]->world->set_fixed_dt(fixed_dt);
+	update_halo();
+}
+
+//widens the halo to the largest radius plus the distance two balls at MAX_SPEED close in a step, up to
+//half a tile, and resizes the worlds of the active tiles to cover it
+void ChunkedWorld::update_halo()
+{
+	float need = max_radius + 2 * MAX_SPEED * fixed_dt;
+	float h = need>DOMAIN_HALO ? need : DOMAIN_HALO;
+	size_t k;
+
+	//ghosts only come from the eight tiles around, and walls are handed to the tiles within half a tile
+	if (h>chunk_size / 2) h = chunk_size / 2;
+	if (h == halo) return;
+	halo = h;
+
+	for (k = 0; k<active.size(); k++)
+	{
+		sf::FloatRect r = get_chunk_rect(active[k]->col, active[k]->row);
+		active[k]->world->set_area(sf::FloatRect(r.left - halo, r.top - halo, r.width + 2 * halo, r.height + 2 * halo));
+		active[k]->world->set_border(whole);
+	}
+}
+
+//only allows nonnegative ranges, and a cold range no shorter than the active one.
+//takes effect at the next step
+void ChunkedWorld::set_ranges(float act, float cold)
+{
+	active_range = act<0 ? -act : act;
+	cold_range = cold<0 ? -cold : cold;
+	if (cold_range<active_range) cold_range = active_range;
+}
+
+//returns the tile at the argument column and row
+sf::FloatRect ChunkedWorld::get_chunk_rect(int col, int row) const
+{
+	return sf::FloatRect(whole.left + col * chunk_size, whole.top + row * chunk_size, chunk_size, chunk_size);
+}
+
+//returns the tile containing the argument point, or that nearest it if the point is outside the world.
+//a tile that has never been used is created if create is true, and null is returned otherwise
+ChunkedWorld::Chunk *ChunkedWorld::find_chunk(float x, float y, bool create)
+{
+	int col = (int)floor((x - whole.left) / chunk_size);
+	int row = (int)floor((y - whole.top) / chunk_size);
+
+	if (col<0) col = 0;
+	if (col >= cols) col = cols - 1;
+	if (row<0) row = 0;
+	if (row >= rows) row = rows - 1;
+	return find_chunk(col, row, create);
+}
+
+//returns the tile at the argument column and row, which must be in the world
+ChunkedWorld::Chunk *ChunkedWorld::find_chunk(int col, int row, bool create)
+{
+	std::unordered_map<long long, std::unique_ptr<Chunk> >::iterator it = chunks.find(get_key(col, row));
+	unsigned count = 0;
+
+	if (it != chunks.end()) return it->second.get();
+	if (!create) return 0;
+
+	Chunk *c = new Chunk();
+	c->col = col;
+	c->row = row;
+	c->wall_step = step_count;
+	c->stored.resize(sizeof(count));
+	memcpy(&c->stored[0], &count, sizeof(count));
+	chunks[get_key(col, row)].reset(c);
+	return c;
+}
+
+//returns the distance from the argument tile to the nearest focus point, or -1 if there are none
+float ChunkedWorld::focus_distance(const Chunk &c) const
+{
+	sf::FloatRect r = get_chunk_rect(c.col, c.row);
+	float best = -1;
+	size_t k;
+
+	for (k = 0; k<focus.size(); k++)
+	{
+		float dx = focus[k].x<r.left ? r.left - focus[k].x : focus[k].x>r.left + r.width ? focus[k].x - r.left - r.width : 0;
+		float dy = focus[k].y<r.top ? r.top - focus[k].y : focus[k].y>r.top + r.height ? focus[k].y - r.top - r.height : 0;
+		float d = sqrt(dx*dx + dy*dy);
+
+		if (best<0 || d<best) best = d;
+	}
+	return best;
+}
+
+//moves the moving walls stored in a cold tile on to the current step, one fixed step at a time as an
+//active tile moves them, so that they match their copies in the tiles that stayed active
+void ChunkedWorld::move_stored_walls(Chunk &c)
+{
+	unsigned num_walls;
+	size_t at = sizeof(num_walls);
+	unsigned i;
+	long long s;
+
+	memcpy(&num_walls, &c.stored[0], sizeof(num_walls));
+	for (i = 0; i<num_walls && c.wall_step<step_count; i++, at += sizeof(WallRecord))
+	{
+		WallRecord r;
+		memcpy(&r, &c.stored[at], sizeof(r));
+
+		Wall w = make_wall(r);
+		if (!w.is_kinematic()) continue;
+		for (s = c.wall_step; s<step_count; s++)
+			w.move(fixed_dt);
+
+		r = make_wall_record(w);
+		memcpy(&c.stored[at], &r, sizeof(r));
+	}
+	c.wall_step = step_count;
+}
+
+//unpacks a cold tile into a new World, which covers the tile plus the halo and bounces balls off the
+//border of the whole world
+void ChunkedWorld::activate(Chunk &c)
+{
+	sf::FloatRect r = get_chunk_rect(c.col, c.row);
+	unsigned num_walls;
+	size_t at = sizeof(num_walls);
+	unsigned i;
+
+	c.world.reset(new World(sf::FloatRect(r.left - halo, r.top - halo, r.width + 2 * halo, r.height + 2 * halo), fixed_dt));
+	c.world->set_border(whole);
+
+	move_stored_walls(c);
+	memcpy(&num_walls, &c.stored[0], sizeof(num_walls));
+	for (i = 0; i<num_walls; i++, at += sizeof(WallRecord))
+	{
+		WallRecord w;
+		memcpy(&w, &c.stored[at], sizeof(w));
+		c.world->add_wall(make_wall(w));
+	}
+
+	c.owned.resize((c.stored.size() - at) / sizeof(DomainBall));
+	if (!c.owned.empty()) memcpy(&c.owned[0], &c.stored[at], c.owned.size() * sizeof(DomainBall));
+	std::vector<unsigned char>().swap(c.stored);
+
+	active.insert(std::lower_bound(active.begin(), active.end(), &c, [this](const Chunk *a, const Chunk *b)
+		{ return get_key(a->col, a->row)<get_key(b->col, b->row); }), &c);
+	num_restored++;
+}
+
+//packs an active tile's walls and balls into its stored bytes and frees its World
+void ChunkedWorld::deactivate(Chunk &c)
+{
+	unsigned num_walls = c.world->get_num_walls();
+	size_t at = sizeof(num_walls);
+	unsigned i;
+
+	c.stored.resize(at + num_walls * sizeof(WallRecord) + c.owned.size() * sizeof(DomainBall));
+	memcpy(&c.stored[0], &num_walls, sizeof(num_walls));
+	for (i = 0; i<num_walls; i++, at += sizeof(WallRecord))
+	{
+		WallRecord r = make_wall_record(c.world->get_wall(i));
+		memcpy(&c.stored[at], &r, sizeof(r));
+	}
+	if (!c.owned.empty()) memcpy(&c.stored[at], &c.owned[0], c.owned.size() * sizeof(DomainBall));
+	c.wall_step = step_count;
+
+	c.world.reset();
+	std::vector<DomainBall>().swap(c.owned);
+	std::vector<DomainBall>().swap(c.loaded);
+	active.erase(std::find(active.begin(), active.end(), &c));
+	num_stored++;
+}
+
+//appends ball d to the stored bytes of the argument cold tile
+void ChunkedWorld::store_ball(Chunk &c, const DomainBall &d)
+{
+	size_t at = c.stored.size();
+
+	c.stored.resize(at + sizeof(d));
+	memcpy(&c.stored[at], &d, sizeof(d));
+}
+
+//stores the active tiles out of every focus point's cold range, then restores the cold tiles within
+//one's active range. only the tiles around the focus points are looked at
+void ChunkedWorld::update_activity()
+{
+	size_t k;
+	int col, row;
+
+	for (k = active.size(); k-->0;)
+	{
+		float d = focus_distance(*active[k]);
+		if (d<0 || d>cold_range) deactivate(*active[k]);
+	}
+
+	for (k = 0; k<focus.size(); k++)
+	{
+		int c0 = (int)floor((focus[k].x - active_range - whole.left) / chunk_size);
+		int c1 = (int)floor((focus[k].x + active_range - whole.left) / chunk_size);
+		int r0 = (int)floor((focus[k].y - active_range - whole.top) / chunk_size);
+		int r1 = (int)floor((focus[k].y + active_range - whole.top) / chunk_size);
+
+		if (c0<0) c0 = 0;
+		if (c1 >= cols) c1 = cols - 1;
+		if (r0<0) r0 = 0;
+		if (r1 >= rows) r1 = rows - 1;
+
+		for (row = r0; row <= r1; row++)
+		{
+			for (col = c0; col <= c1; col++)
+			{
+				Chunk *c = find_chunk(col, row, false);
+				if (c && !c->world && focus_distance(*c) <= active_range) activate(*c);
+			}
+		}
+	}
+}
+
+//refills the argument tile's world with its owned balls followed by ghosts of the balls of the active
+//tiles around it that are within the halo of it
+void ChunkedWorld::load_chunk(Chunk &c)
+{
+	sf::FloatRect r = get_chunk_rect(c.col, c.row);
+	BallSystem &balls = c.world->get_balls();
+	int dc, dr;
+	size_t j;
+
+	c.loaded = c.owned;
+	for (dr = -1; dr <= 1; dr++)
+	{
+		for (dc = -1; dc <= 1; dc++)
+		{
+			int col = c.col + dc;
+			int row = c.row + dr;
+			if ((dc == 0 && dr == 0) || col<0 || col >= cols || row<0 || row >= rows) continue;
+
+			Chunk *n = find_chunk(col, row, false);
+			if (!n || !n->world) continue;
+
+			for (j = 0; j<n->owned.size(); j++)
+			{
+				const DomainBall &d = n->owned[j];
+				float dx = d.x<r.left ? r.left - d.x : d.x>r.left + r.width ? d.x - r.left - r.width : 0;
+				float dy = d.y<r.top ? r.top - d.y : d.y>r.top + r.height ? d.y - r.top - r.height : 0;
+				float reach = d.radius + halo;
+
+				if (dx*dx + dy*dy<reach*reach) c.loaded.push_back(d);
+			}
+		}
+	}
+
+	c.world->clear_balls();
+	balls.reserve((int)c.loaded.size());
+	for (j = 0; j<c.loaded.size(); j++)
+	{
+		const DomainBall &d = c.loaded[j];
+		int i = balls.add(sf::Vector2f(d.x, d.y), sf::Vector2f(d.vx, d.vy), d.radius, d.color, d.density);
+		balls.set_velocity(i, sf::Vector2f(d.vx, d.vy));
+	}
+}
+
+//copies the owned balls back out of the argument tile's world after a step, dropping the ghosts
+void ChunkedWorld::save_chunk(Chunk &c)
+{
+	const BallSystem &balls = c.world->get_balls();
+	int num_owned = (int)c.owned.size();
+	int i;
+
+	c.owned.clear();
+	for (i = 0; i<balls.size(); i++)
+	{
+		int id = balls.get_id(i);
+		if (id >= num_owned) continue;
+
+		DomainBall d = c.loaded[id];
+		d.x = balls.get_position(i).x;
+		d.y = balls.get_position(i).y;
+		d.vx = balls.get_velocity(i).x;
+		d.vy = balls.get_velocity(i).y;
+		c.owned.push_back(d);
+	}
+}
+
+//moves the balls that left their tile to the tile they are in now. a tile that is cold takes them
+//without being unpacked, unless a focus point is within its active range
+void ChunkedWorld::migrate()
+{
+	std::vector<DomainBall> moving;
+	size_t j, k;
+
+	for (k = 0; k<active.size(); k++)
+	{
+		Chunk &c = *active[k];
+		sf::FloatRect r = get_chunk_rect(c.col, c.row);
+		size_t kept = 0;
+
+		for (j = 0; j<c.owned.size(); j++)
+		{
+			const DomainBall &d = c.owned[j];
+			bool inside = d.x >= r.left && d.x<r.left + r.width && d.y >= r.top && d.y<r.top + r.height;
+
+			//balls pushed past the world's edge belong to the tile at the edge
+			if (inside || find_chunk(d.x, d.y, true) == &c) c.owned[kept++] = d;
+			else moving.push_back(d);
+		}
+		c.owned.resize(kept);
+	}
+
+	for (j = 0; j<moving.size(); j++)
+	{
+		Chunk *c = find_chunk(moving[j].x, moving[j].y, true);
+
+		if (!c->world)
+		{
+			float d = focus_distance(*c);
+			if (d >= 0 && d <= active_range) activate(*c);
+		}
+		if (c->world) c->owned.push_back(moving[j]);
+		else store_ball(*c, moving[j]);
+	}
+}
+
+//returns the memory taken by the cold tiles' stored balls and walls, in bytes
+size_t ChunkedWorld::get_stored_bytes() const
+{
+	std::unordered_map<long long, std::unique_ptr<Chunk> >::const_iterator it;
+	size_t total = 0;
+
+	for (it = chunks.begin(); it != chunks.end(); ++it)
+		total += it->second->stored.size();
+	return total;
+}
+
+//appends the balls of every active tile, ghosts excluded
+void ChunkedWorld::get_active_balls(std::vector<DomainBall> &out) const
+{
+	size_t k;
+
+	for (k = 0; k<active.size(); k++)
+		out.insert(out.end(), active[k]->owned.begin(), active[k]->owned.end());
+}
+
+//adds a ball to the tile containing its centre and returns its id, which it keeps wherever it moves.
+//a cold tile stores it without being unpacked. returns -1 for a ball outside the world
+int ChunkedWorld::add_ball(const Ball &b)
+{
+	float x = b.getx();
+	float y = b.gety();
+
+	if (x<whole.left || x >= whole.left + whole.width || y<whole.top || y >= whole.top + whole.height) return -1;
+
+	Chunk *c = find_chunk(x, y, true);
+	DomainBall d = { next_id, x, y, b.get_velocity().x, b.get_velocity().y, b.get_radius(), b.get_density(), b.get_color() };
+
+	if (c->world) c->owned.push_back(d);
+	else store_ball(*c, d);
+	if (d.radius>max_radius)
+	{
+		max_radius = d.radius;
+		update_halo();
+	}
+	num_balls++;
+	return next_id++;
+}
+
+//adds a copy of the argument wall to every tile within half a tile of it, the widest the halo gets, so
+//that balls added later cannot outgrow the tiles that have it.
+//returns false if it reaches none, being outside the world
+bool ChunkedWorld::add_wall(const Wall &w)
+{
+	WallRecord rec = make_wall_record(w);
+	float margin = chunk_size / 2;
+	float box[4];
+	bool added = false;
+	int col, row;
+
+	get_wall_box(w, box);
+	int c0 = (int)floor((box[0] - margin - whole.left) / chunk_size);
+	int c1 = (int)floor((box[2] + margin - whole.left) / chunk_size);
+	int r0 = (int)floor((box[1] - margin - whole.top) / chunk_size);
+	int r1 = (int)floor((box[3] + margin - whole.top) / chunk_size);
+
+	if (c0<0) c0 = 0;
+	if (c1 >= cols) c1 = cols - 1;
+	if (r0<0) r0 = 0;
+	if (r1 >= rows) r1 = rows - 1;
+
+	for (row = r0; row <= r1; row++)
+	{
+		for (col = c0; col <= c1; col++)
+		{
+			Chunk *c = find_chunk(col, row, true);
+			added = true;
+
+			if (c->world)
+			{
+				c->world->add_wall(w);
+				continue;
+			}
+
+			//the walls come before the balls in the stored bytes, and are all kept at the same step
+			move_stored_walls(*c);
+			unsigned num_walls;
+			memcpy(&num_walls, &c->stored[0], sizeof(num_walls));
+			size_t at = sizeof(num_walls) + num_walls * sizeof(WallRecord);
+
+			c->stored.insert(c->stored.begin() + at, sizeof(rec), 0);
+			memcpy(&c->stored[at], &rec, sizeof(rec));
+			num_walls++;
+			memcpy(&c->stored[0], &num_walls, sizeof(num_walls));
+		}
+	}
+	return added;
+}
+
+//adds a point around which tiles are simulated and returns its index
+int ChunkedWorld::add_focus(sf::Vector2f pt)
+{
+	focus.push_back(pt);
+	return (int)focus.size() - 1;
+}
+
+//moves the focus point of the argument index. tiles follow at the next step
+void ChunkedWorld::move_focus(int k, sf::Vector2f pt)
+{
+	focus[k] = pt;
+}
+
+//removes every focus point; every tile goes cold at the next step
+void ChunkedWorld::clear_focus()
+{
+	focus.clear();
+}
+
+//brings the set of active tiles up to date with the focus points, then advances every active tile by one
+//fixed step, on the pool if there is one, and moves balls between tiles. cold tiles stand still
+void ChunkedWorld::tick()
+{
+	size_t k;
+
+	update_activity();
+
+	for (k = 0; k<active.size(); k++)
+		load_chunk(*active[k]);
+
+	if (pool && active.size()>1)
+	{
+		pool->parallel_for((int)active.size(), 1, [this](int begin, int end)
+		{
+			int i;
+			for (i = begin; i<end; i++)
+				active[i]->world->tick();
+		});
+	}
+	else
+	{
+		for (k = 0; k<active.size(); k++)
+			active[k]->world->tick();
+	}
+
+	for (k = 0; k<active.size(); k++)
+		save_chunk(*active[k]);
+	migrate();
+	step_count++;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "ball.h"
+#include "World.h"
+#include "Domain.h"
+#include "ThreadPool.h"
+
+const float CHUNK_SIZE = 1024;              //default width and height of a tile
+const float CHUNK_ACTIVE_RANGE = 1024;      //default distance from a focus point within which tiles are simulated
+const float CHUNK_COLD_RANGE = 1536;        //default distance beyond which they are stored again, > CHUNK_ACTIVE_RANGE
+
+//a world far bigger than the part of it being watched, cut into square tiles that each own their balls
+//and walls. only tiles near a focus point (a camera, a player) are active: each has a World covering
+//the tile plus a halo, and is stepped with ghosts of the balls near it in active neighbouring tiles,
+//as ranks are in a Domain. a tile goes cold once every focus point is out of its cold range; its balls
+//and walls are then packed into one block of bytes and its World is freed. a cold tile is only
+//unpacked when a focus point comes within its active range again, and balls that move into it in the
+//meantime are appended to the block. tiles that never held anything take no memory at all, so memory
+//and time grow with the active area and the number of balls, not with the size of the world.
+//balls in cold tiles stand still, and active balls do not see them, so the cold range should leave at
+//least a tile between anything being watched and the edge of the simulated area. moving walls do not:
+//a tile made active again first moves its walls by the steps it was cold, so the copies of a wall in
+//neighbouring tiles stay in the same place. a wall belongs to the tiles it reaches when it is added,
+//so one that moves should be short of the edge of those tiles by its whole travel.
+//the halo grows with the largest ball added, as a Domain's does, up to half a tile
+class ChunkedWorld
+{
+private:
+	struct Chunk
+	{
+		int col;
+		int row;
+		std::unique_ptr<World> world;           //null while the tile is cold
+		std::vector<DomainBall> owned;          //while active, between steps, in the world's last order
+		std::vector<DomainBall> loaded;         //owned balls, then ghosts, as loaded into the world
+		std::vector<unsigned char> stored;      //while cold: walls, then balls (see ChunkedWorld.cpp)
+		long long wall_step;                    //while cold: the step the stored walls were last moved to
+	};
+
+	sf::FloatRect whole;                        //area of the whole world
+	float chunk_size;                           // > 0
+	int cols;                                   //tiles across and down
+	int rows;
+	float halo;                                 //the larger of DOMAIN_HALO and what the balls need, <= chunk_size / 2
+	float max_radius;                           //of every ball added
+	float fixed_dt;
+	float active_range;
+	float cold_range;                           // >= active_range
+
+	std::unordered_map<long long, std::unique_ptr<Chunk> > chunks;     //by row * cols + col, once used
+	std::vector<Chunk *> active;                                        //in key order
+	std::vector<sf::Vector2f> focus;
+	std::shared_ptr<ThreadPool> pool;
+
+	long long step_count;
+	int next_id;                                //ids are unique over the whole world
+	int num_balls;
+	long long num_restored;                     //tiles made active again so far
+	long long num_stored;                       //tiles made cold so far
+
+	long long get_key(int col, int row) const   { return (long long)row * cols + col; }
+	void set_layout(float size);
+	void update_halo();
+	void move_stored_walls(Chunk &c);
+	sf::FloatRect get_chunk_rect(int col, int row) const;
+	Chunk *find_chunk(float x, float y, bool create);
+	Chunk *find_chunk(int col, int row, bool create);
+	float focus_distance(const Chunk &c) const;
+	void activate(Chunk &c);
+	void deactivate(Chunk &c);
+	void update_activity();
+	void load_chunk(Chunk &c);
+	void save_chunk(Chunk &c);
+	void migrate();
+	void store_ball(Chunk &c, const DomainBall &d);
+
+	ChunkedWorld(const ChunkedWorld &);
+	ChunkedWorld &operator=(const ChunkedWorld &);
+
+public:
+	//Constructors
+	ChunkedWorld(sf::FloatRect area);
+	ChunkedWorld(sf::FloatRect area, float size);
+
+	//Getters
+	sf::FloatRect get_area() const              { return whole; }
+	float get_chunk_size() const                { return chunk_size; }
+	float get_halo() const                      { return halo; }
+	float get_fixed_dt() const                  { return fixed_dt; }
+	float get_active_range() const              { return active_range; }
+	float get_cold_range() const                { return cold_range; }
+	long long get_step_count() const            { return step_count; }
+	int get_num_balls() const                   { return num_balls; }
+	int get_num_chunks() const                  { return (int)chunks.size(); }
+	int get_num_active() const                  { return (int)active.size(); }
+	long long get_num_restored() const          { return num_restored; }
+	long long get_num_stored() const            { return num_stored; }
+	int get_num_focus() const                   { return (int)focus.size(); }
+	sf::Vector2f get_focus(int k) const         { return focus[k]; }
+	const World &get_active_world(int k) const  { return *active[k]->world; }
+
+	size_t get_stored_bytes() const;
+	void get_active_balls(std::vector<DomainBall> &out) const;
+
+	//Setters
+	void set_fixed_dt(float dt);
+	void set_ranges(float act, float cold);
+	void set_pool(const std::shared_ptr<ThreadPool> &p)     { pool = p; }
+
+	//Other functions
+	int add_ball(const Ball &b);
+	bool add_wall(const Wall &w);
+	int add_focus(sf::Vector2f pt);
+	void move_focus(int k, sf::Vector2f pt);
+	void clear_focus();
+	void tick();
+};
@@ -0,0 +1,131 @@
+#include "ContactStream.h"
+
+const int RING_CACHE_SIZE = 4;              //streams each thread remembers its ring in; a power of two
+
+static std::atomic<long long> next_serial(0);
+
+//the ring this thread writes to in a few recently used streams, by stream serial. a null ring is
+//cached too: the thread found every ring taken and drops its records for that stream
+static thread_local long long cached_serial[RING_CACHE_SIZE] = { -1, -1, -1, -1 };
+static thread_local ContactRing *cached_ring[RING_CACHE_SIZE];
+
+//Default ContactStream constructor - no rings until a thread writes
+ContactStream::ContactStream()
+{
+	int k;
+
+	serial = next_serial++;
+	num_rings = 0;
+	dropped = 0;
+	for (k = 0; k<MAX_CONTACT_THREADS; k++)
+		rings[k] = 0;
+}
+
+//no thread may still be writing to the stream
+ContactStream::~ContactStream()
+{
+	int k;
+
+	for (k = 0; k<MAX_CONTACT_THREADS; k++)
+		delete rings[k].load();
+}
+
+//records lost so far because a ring was full or there were too many writing threads
+long long ContactStream::get_num_dropped() const
+{
+	long long n = dropped.load(std::memory_order_relaxed);
+	int k;
+
+	for (k = 0; k<MAX_CONTACT_THREADS; k++)
+	{
+		ContactRing *ring = rings[k].load(std::memory_order_acquire);
+		if (ring) n += ring->dropped.load(std::memory_order_relaxed);
+	}
+	return n;
+}
+
+//returns the calling thread's ring, claiming one the first time the thread writes to this stream,
+//or null if every ring is taken. the answer, null included, is cached per thread, so the search is
+//rarely repeated. slots are claimed with a compare-exchange, so num_rings never passes MAX_CONTACT_THREADS
+ContactRing *ContactStream::get_ring()
+{
+	int slot = (int)(serial & (RING_CACHE_SIZE - 1));
+	std::thread::id me = std::this_thread::get_id();
+	ContactRing *ring = 0;
+	int n, k;
+
+	if (cached_serial[slot] == serial) return cached_ring[slot];
+
+	n = num_rings.load(std::memory_order_acquire);
+	for (k = 0; k<n && k<MAX_CONTACT_THREADS; k++)
+	{
+		ContactRing *r = rings[k].load(std::memory_order_acquire);
+		if (r && r->owner == me) ring = r;
+	}
+
+	if (!ring)
+	{
+		k = num_rings.load(std::memory_order_relaxed);
+		while (k<MAX_CONTACT_THREADS && !num_rings.compare_exchange_weak(k, k + 1));
+
+		if (k<MAX_CONTACT_THREADS)
+		{
+			ring = new ContactRing();
+			ring->owner = me;
+			ring->head = 0;
+			ring->tail = 0;
+			ring->dropped = 0;
+			rings[k].store(ring, std::memory_order_release);
+		}
+	}
+
+	cached_serial[slot] = serial;
+	cached_ring[slot] = ring;
+	return ring;
+}
+
+//adds a record to the calling thread's ring, or drops it if the ring is full. never waits
+void ContactStream::push(const Contact &c)
+{
+	ContactRing *ring = get_ring();
+
+	if (!ring)
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	unsigned t = ring->tail.load(std::memory_order_relaxed);
+	if (t - ring->head.load(std::memory_order_acquire) >= (unsigned)CONTACT_RING_SIZE)
+	{
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring->records[t & (CONTACT_RING_SIZE - 1)] = c;
+	ring->tail.store(t + 1, std::memory_order_release);
+}
+
+//appends every record written so far to out and returns how many there were.
+//records of one thread come out in the order they were written, and threads one after another,
+//so records are not sorted by step across threads. may be called from any thread, while the
+//writers run; concurrent calls take turns
+int ContactStream::drain(std::vector<Contact> &out)
+{
+	std::lock_guard<std::mutex> guard(drain_lock);
+	int count = 0;
+	int k;
+
+	for (k = 0; k<MAX_CONTACT_THREADS; k++)
+	{
+		ContactRing *ring = rings[k].load(std::memory_order_acquire);
+		if (!ring) continue;
+
+		unsigned h = ring->head.load(std::memory_order_relaxed);
+		unsigned t = ring->tail.load(std::memory_order_acquire);
+		for (; h != t; h++, count++)
+			out.push_back(ring->records[h & (CONTACT_RING_SIZE - 1)]);
+		ring->head.store(h, std::memory_order_release);
+	}
+	return count;
+}
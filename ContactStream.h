@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int CONTACT_RING_SIZE = 4096;         //records each thread can have waiting in a stream; a power of two
+const int MAX_CONTACT_THREADS = 64;         //threads that can write to one stream; others' records are dropped
+const int BORDER_INDEX = -1;                //wall index of a WALL_CONTACT with the border of the world
+
+enum ContactType { BALL_CONTACT, WALL_CONTACT };
+
+//one resolved impact: two balls, or a ball and a wall
+struct Contact
+{
+	long long step;         //step it happened in: World::get_step_count() once that step has finished
+	int a;                  //ball id
+	int b;                  //other ball id, or wall index (BORDER_INDEX for the border)
+	ContactType type;
+	float x, y;             //point of contact
+	float speed;            //speed at which the two were approaching along the contact normal, > 0
+};
+
+//records of one writing thread, read by one reader at a time.
+//the writer only moves tail and the reader only moves head, so neither ever waits for the other
+struct ContactRing
+{
+	std::thread::id owner;
+	alignas(64) std::atomic<unsigned> head;     //next record to read
+	alignas(64) std::atomic<unsigned> tail;     //next record to write
+	std::atomic<long long> dropped;             //records lost because the ring was full
+	Contact records[CONTACT_RING_SIZE];
+};
+
+//a bounded, lock-free queue of contacts from the physics threads to a consumer such as audio or scoring.
+//each thread that writes gets its own ring the first time it does, so writers never contend; drain()
+//collects whatever all of them have written. when a ring is full new records are dropped and
+//counted instead of waiting for the consumer, so a slow consumer never stalls the step.
+//subscribe a stream to a World to receive its contacts (see World::subscribe)
+class ContactStream
+{
+private:
+	long long serial;                                       //tells streams apart in the writers' caches
+	std::atomic<int> num_rings;                             //ring slots claimed
+	std::atomic<ContactRing *> rings[MAX_CONTACT_THREADS];  //null until the claiming thread has set it up
+	std::atomic<long long> dropped;                         //records of threads that found no ring left
+	std::mutex drain_lock;                                  //readers take turns
+
+	ContactRing *get_ring();
+
+	ContactStream(const ContactStream &);
+	ContactStream &operator=(const ContactStream &);
+
+public:
+	//Constructors
+	ContactStream();
+	~ContactStream();
+
+	//Getters
+	long long get_num_dropped() const;
+
+	//Other functions
+	void push(const Contact &c);
+	int drain(std::vector<Contact> &out);
+};
@@ -0,0 +1,326 @@
+#include <cstring>
+#include <math.h>
+#include "Domain.h"
+
+//Constructor - the halo is at least DOMAIN_HALO wide
+Domain::Domain(Transport &t, sf::FloatRect area)
+{
+	transport = &t;
+	whole = area;
+	min_halo = DOMAIN_HALO;
+	halo = min_halo;
+	max_radius = 0;
+	num_ghosts = 0;
+	num_migrated = 0;
+	set_layout();
+}
+
+//Constructor
+Domain::Domain(Transport &t, sf::FloatRect area, float h)
+{
+	transport = &t;
+	whole = area;
+	min_halo = h<0 ? -h : h;
+	halo = min_halo;
+	max_radius = 0;
+	num_ghosts = 0;
+	num_migrated = 0;
+	set_layout();
+}
+
+//sets the least width of the halo; only allows nonnegative widths
+void Domain::set_halo(float h)
+{
+	min_halo = h<0 ? -h : h;
+	update_halo();
+}
+
+//widens the halo to the largest radius plus the distance two balls at MAX_SPEED close in a step, or
+//narrows it back to min_halo, and resizes the world to cover it. walls the wider world now reaches
+//are added to it
+void Domain::update_halo()
+{
+	float need = max_radius + 2 * MAX_SPEED * world.get_fixed_dt();
+	float h = need>min_halo ? need : min_halo;
+
+	if (h == halo) return;
+	halo = h;
+
+	sf::FloatRect r = get_region();
+	world.set_area(sf::FloatRect(r.left - halo, r.top - halo, r.width + 2 * halo, r.height + 2 * halo));
+	world.set_border(whole);
+	admit_far_walls();
+}
+
+//returns whether the box of the argument wall overlaps the world's area
+bool Domain::wall_reaches_world(const Wall &w) const
+{
+	sf::FloatRect a = world.get_area();
+	float box[4];
+
+	get_wall_box(w, box);
+	return !(box[2]<a.left || box[0]>a.left + a.width || box[3]<a.top || box[1]>a.top + a.height);
+}
+
+//adds the far walls the world reaches now. a moving one is first moved on by the steps since it was
+//handed over, a fixed step at a time, so it matches the copies other ranks have been moving
+void Domain::admit_far_walls()
+{
+	size_t kept = 0;
+	size_t k;
+	long long s;
+
+	for (k = 0; k<far_walls.size(); k++)
+	{
+		Wall w = far_walls[k];
+
+		for (s = far_steps[k]; w.is_kinematic() && s<world.get_step_count(); s++)
+			w.move(world.get_fixed_dt());
+
+		if (wall_reaches_world(w)) world.add_wall(w);
+		else
+		{
+			far_walls[kept] = far_walls[k];
+			far_steps[kept++] = far_steps[k];
+		}
+	}
+	far_walls.resize(kept);
+	far_steps.resize(kept);
+}
+
+//picks the grid of regions whose cells are closest to square, sizes the world to this rank's region
+//plus the halo and lists the ranks of the regions around it
+void Domain::set_layout()
+{
+	int size = transport->get_size();
+	int rank = transport->get_rank();
+	float best = -1;
+	int c, dc, dr;
+
+	cols = 1;
+	for (c = 1; c <= size; c++)
+	{
+		if (size % c != 0) continue;
+
+		float score = log((whole.width / c) / (whole.height / (size / c)));
+		if (score<0) score = -score;
+		if (best<0 || score<best)
+		{
+			best = score;
+			cols = c;
+		}
+	}
+	rows = size / cols;
+
+	sf::FloatRect r = get_region(rank);
+	world.set_area(sf::FloatRect(r.left - halo, r.top - halo, r.width + 2 * halo, r.height + 2 * halo));
+	world.set_border(whole);
+
+	neighbours.clear();
+	for (dr = -1; dr <= 1; dr++)
+	{
+		for (dc = -1; dc <= 1; dc++)
+		{
+			int col = rank % cols + dc;
+			int row = rank / cols + dr;
+
+			if ((dc != 0 || dr != 0) && col >= 0 && col<cols && row >= 0 && row<rows)
+				neighbours.push_back(row * cols + col);
+		}
+	}
+	out.resize(neighbours.size());
+	in.resize(neighbours.size());
+}
+
+//returns the region owned by the argument rank. neighbouring regions share their edges exactly
+sf::FloatRect Domain::get_region(int rank) const
+{
+	int col = rank % cols;
+	int row = rank / cols;
+	float left = whole.left + whole.width * col / cols;
+	float top = whole.top + whole.height * row / rows;
+	float right = col + 1 == cols ? whole.left + whole.width : whole.left + whole.width * (col + 1) / cols;
+	float bottom = row + 1 == rows ? whole.top + whole.height : whole.top + whole.height * (row + 1) / rows;
+
+	return sf::FloatRect(left, top, right - left, bottom - top);
+}
+
+//returns the rank owning the argument point. points outside the area belong to the nearest region
+int Domain::find_rank(float x, float y) const
+{
+	int col = whole.width>0 ? (int)floor((x - whole.left) / whole.width * cols) : 0;
+	int row = whole.height>0 ? (int)floor((y - whole.top) / whole.height * rows) : 0;
+
+	if (col<0) col = 0;
+	if (col >= cols) col = cols - 1;
+	if (row<0) row = 0;
+	if (row >= rows) row = rows - 1;
+	return row * cols + col;
+}
+
+//returns the index in neighbours of the region one step from this one towards the argument rank's
+int Domain::toward(int rank) const
+{
+	int me = transport->get_rank();
+	int dc = rank % cols - me % cols;
+	int dr = rank / cols - me / cols;
+	int next = (me / cols + (dr>0) - (dr<0)) * cols + me % cols + (dc>0) - (dc<0);
+	int k;
+
+	for (k = 0; k<(int)neighbours.size(); k++)
+		if (neighbours[k] == next) return k;
+	return 0;
+}
+
+//adds a ball to the simulation under a unique id if its centre is in this rank's region. every rank
+//must be handed the whole scene, so they all size their halos for the largest ball.
+//returns whether the ball was kept
+bool Domain::add_ball(int id, const Ball &b)
+{
+	if (b.get_radius()>max_radius)
+	{
+		max_radius = b.get_radius();
+		update_halo();
+	}
+	if (find_rank(b.getx(), b.gety()) != get_rank()) return false;
+
+	DomainBall d = { id, b.getx(), b.gety(), b.get_velocity().x, b.get_velocity().y, b.get_radius(), b.get_density(), b.get_color() };
+	owned.push_back(d);
+	return true;
+}
+
+//adds a copy of the argument wall if it reaches into this rank's world, or keeps it aside until the
+//halo grows enough for it to. returns whether it was added to the world now
+bool Domain::add_wall(const Wall &w)
+{
+	if (!wall_reaches_world(w))
+	{
+		far_walls.push_back(w);
+		far_steps.push_back(world.get_step_count());
+		return false;
+	}
+
+	world.add_wall(w);
+	return true;
+}
+
+//sends the balls in out to the neighbours and receives theirs into in
+bool Domain::send_balls()
+{
+	return transport->exchange(neighbours, out, in);
+}
+
+//appends ball d to the message m
+static void pack(std::vector<char> &m, const DomainBall &d)
+{
+	size_t at = m.size();
+
+	m.resize(at + sizeof(d));
+	memcpy(&m[at], &d, sizeof(d));
+}
+
+//appends the balls of the message m to bs
+static void unpack(const std::vector<char> &m, std::vector<DomainBall> &bs)
+{
+	size_t n = m.size() / sizeof(DomainBall);
+	size_t at = bs.size();
+
+	bs.resize(at + n);
+	if (n>0) memcpy(&bs[at], &m[0], n * sizeof(DomainBall));
+}
+
+//refills the world with the owned balls followed by the ghosts in in, keeping their speeds as they are
+void Domain::load_world()
+{
+	BallSystem &balls = world.get_balls();
+	int k;
+
+	loaded = owned;
+	for (k = 0; k<(int)in.size(); k++)
+		unpack(in[k], loaded);
+	num_ghosts = (int)(loaded.size() - owned.size());
+
+	world.clear_balls();
+	balls.reserve((int)loaded.size());
+	for (k = 0; k<(int)loaded.size(); k++)
+	{
+		const DomainBall &d = loaded[k];
+		int i = balls.add(sf::Vector2f(d.x, d.y), sf::Vector2f(d.vx, d.vy), d.radius, d.color, d.density);
+		balls.set_velocity(i, sf::Vector2f(d.vx, d.vy));
+	}
+}
+
+//copies the owned balls back out of the world after a step, in the world's order, dropping the ghosts
+void Domain::save_owned()
+{
+	const BallSystem &balls = world.get_balls();
+	int num_owned = (int)owned.size();
+	int i;
+
+	owned.clear();
+	for (i = 0; i<balls.size(); i++)
+	{
+		int id = balls.get_id(i);
+		if (id >= num_owned) continue;
+
+		DomainBall d = loaded[id];
+		d.x = balls.get_position(i).x;
+		d.y = balls.get_position(i).y;
+		d.vx = balls.get_velocity(i).x;
+		d.vy = balls.get_velocity(i).y;
+		owned.push_back(d);
+	}
+}
+
+//advances this rank's part of the simulation by one fixed step, in step with the other ranks, which
+//must all call tick() as well. returns false if a neighbour could not be reached
+bool Domain::tick()
+{
+	int me = get_rank();
+	size_t j, kept = 0;
+	int k;
+
+	update_halo();
+
+	//balls that left the region go to the neighbour in their direction, which passes them on if needed
+	for (k = 0; k<(int)out.size(); k++)
+		out[k].clear();
+	for (j = 0; j<owned.size(); j++)
+	{
+		int r = find_rank(owned[j].x, owned[j].y);
+
+		if (r == me) owned[kept++] = owned[j];
+		else
+		{
+			pack(out[toward(r)], owned[j]);
+			num_migrated++;
+		}
+	}
+	owned.resize(kept);
+	if (!send_balls()) return false;
+	for (k = 0; k<(int)in.size(); k++)
+		unpack(in[k], owned);
+
+	//then every ball near a neighbour's region is sent to it as a ghost
+	for (k = 0; k<(int)out.size(); k++)
+	{
+		sf::FloatRect r = get_region(neighbours[k]);
+
+		out[k].clear();
+		for (j = 0; j<owned.size(); j++)
+		{
+			const DomainBall &d = owned[j];
+			float dx = d.x<r.left ? r.left - d.x : d.x>r.left + r.width ? d.x - r.left - r.width : 0;
+			float dy = d.y<r.top ? r.top - d.y : d.y>r.top + r.height ? d.y - r.top - r.height : 0;
+			float reach = d.radius + halo;
+
+			if (dx*dx + dy*dy<reach*reach) pack(out[k], d);
+		}
+	}
+	if (!send_balls()) return false;
+
+	load_world();
+	world.tick();
+	save_owned();
+	return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include "ball.h"
+#include "World.h"
+#include "Transport.h"
+
+const float DOMAIN_HALO = 2 * rDefault;     //default least width of the band of ghost balls around a region
+
+//a ball as it is sent between ranks
+struct DomainBall
+{
+	int id;                 //unique over all ranks, kept as the ball moves between them
+	float x, y;
+	float vx, vy;
+	float radius;
+	float density;
+	sf::Color color;
+};
+
+//one rank's part of a simulation split over several processes (or threads), each with its own Transport.
+//the area is cut into a grid of rectangular regions, one per rank, as close to square as the number of
+//ranks allows. a rank owns the balls whose centres are in its region and simulates them in a World
+//covering the region plus a halo, which bounces balls off the border of the whole area. every step:
+// - owned balls that left the region migrate to the neighbouring rank in their direction
+// - owned balls within the halo of a neighbour's region are sent to it as ghosts
+// - the world is refilled with the owned balls and the ghosts received, and stepped
+//ghosts collide with owned balls like any other ball, but are thrown away after the step; their owner
+//resolves the same contacts on its side. a contact across a boundary is only seen if the halo is at
+//least the largest ball radius plus the distance two balls can close in a step, so the halo grows to
+//that (at MAX_SPEED) whatever it was set to; it should stay below the size of a region. walls are kept by every
+//rank whose world they reach, and the others hold on to them until a wider halo reaches them. only neighbours communicate, so the cost per rank depends on its own
+//balls and the length of its boundary, not on the number of ranks
+class Domain
+{
+private:
+	Transport *transport;
+	sf::FloatRect whole;                    //area of the whole simulation
+	int cols;                               //regions across and down
+	int rows;
+	float halo;                             //in use: the larger of min_halo and what the balls need
+	float min_halo;                         // >= 0, see set_halo
+	float max_radius;                       //of every ball handed to add_ball, on this rank or another
+
+	World world;
+	std::vector<int> neighbours;            //ranks of the regions around this one
+	std::vector<DomainBall> owned;          //between steps, in the world's last order
+	std::vector<DomainBall> loaded;         //owned balls, then ghosts, as loaded into the world
+	int num_ghosts;
+	long long num_migrated;                 //balls sent to other ranks so far
+
+	std::vector<std::vector<char> > out;    //message to each neighbour
+	std::vector<std::vector<char> > in;     //message from each neighbour
+
+	std::vector<Wall> far_walls;            //handed to add_wall but out of the world's reach so far
+	std::vector<long long> far_steps;       //world step at which each was handed over
+
+	void set_layout();
+	void update_halo();
+	bool wall_reaches_world(const Wall &w) const;
+	void admit_far_walls();
+	int find_rank(float x, float y) const;
+	int toward(int rank) const;
+	bool send_balls();
+	void load_world();
+	void save_owned();
+
+	Domain(const Domain &);
+	Domain &operator=(const Domain &);
+
+public:
+	//Constructors
+	Domain(Transport &t, sf::FloatRect area);
+	Domain(Transport &t, sf::FloatRect area, float h);
+
+	//Getters
+	int get_rank() const                        { return transport->get_rank(); }
+	int get_num_ranks() const                   { return transport->get_size(); }
+	sf::FloatRect get_area() const              { return whole; }
+	sf::FloatRect get_region() const            { return get_region(get_rank()); }
+	float get_halo() const                      { return halo; }
+	int get_num_owned() const                   { return (int)owned.size(); }
+	int get_num_ghosts() const                  { return num_ghosts; }
+	long long get_num_migrated() const          { return num_migrated; }
+	const DomainBall &get_ball(int k) const     { return owned[k]; }
+	const World &get_world() const              { return world; }
+	World &get_world()                          { return world; }
+
+	sf::FloatRect get_region(int rank) const;
+
+	//Setters
+	void set_halo(float h);
+
+	//Other functions
+	bool add_ball(int id, const Ball &b);
+	bool add_wall(const Wall &w);
+	bool tick();
+};
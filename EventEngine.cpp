@@ -0,0 +1,359 @@
+#include "EventEngine.h"
+
+//returns true if e happens after f
+bool LaterEvent::operator()(const CollisionEvent &e, const CollisionEvent &f) const
+{
+	if (e.t != f.t) return e.t>f.t;
+	if (e.a != f.a) return e.a>f.a;
+	if (e.type != f.type) return e.type>f.type;
+	return e.b>f.b;
+}
+
+//Default EventEngine constructor
+EventEngine::EventEngine()
+{
+	num_events = 0;
+	num_overflow = 0;
+	stamp = 0;
+	started = false;
+	now = 0;
+	horizon = 0;
+	last_dt = 0;
+}
+
+//forgets every prediction and predicts every ball's collisions afresh, with engine time starting at 0
+void EventEngine::start(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, float dt)
+{
+	int n = balls.size();
+	int i;
+
+	now = 0;
+	horizon = (double)EVENT_HORIZON_STEPS * dt;
+	last_area = area;
+	last_dt = dt;
+	local_t.assign(n, 0);
+	window_end.assign(n, horizon);
+	counts.assign(n, 0);
+	seen.assign(n, 0);
+	while (!queue.empty()) queue.pop();
+
+	rebuild_grid(balls, area);
+	for (i = 0; i<n; i++)
+		predict(balls, ws, num_walls, bvh, area, i);
+	started = true;
+}
+
+//predicts again the balls whose position, velocity or radius was changed since the last advance()
+//call, or starts over if there are many of them
+void EventEngine::catch_up(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, float dt)
+{
+	int n = balls.size();
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	const float *vx = balls.get_vx();
+	const float *vy = balls.get_vy();
+	const float *r = balls.get_radii();
+	size_t k;
+	int i;
+
+	changed.clear();
+	for (i = 0; i<n; i++)
+	{
+		if (x[i] != last_x[i] || y[i] != last_y[i] || vx[i] != last_vx[i] || vy[i] != last_vy[i] || r[i] != last_r[i])
+			changed.push_back(i);
+	}
+
+	if ((int)changed.size()>n / 4)
+	{
+		start(balls, ws, num_walls, bvh, area, dt);
+		return;
+	}
+
+	//the grid is for finding candidates only, so rebinning it leaves the predictions valid
+	if (num_overflow>n) rebuild_grid(balls, area);
+
+	for (k = 0; k<changed.size(); k++)
+	{
+		counts[changed[k]]++;
+		repredict(balls, ws, num_walls, bvh, area, changed[k]);
+	}
+}
+
+//remembers the balls as this call leaves them, so changes made before the next one can be found
+void EventEngine::save_state(const BallSystem &balls)
+{
+	int n = balls.size();
+
+	last_x.assign(balls.get_x(), balls.get_x() + n);
+	last_y.assign(balls.get_y(), balls.get_y() + n);
+	last_vx.assign(balls.get_vx(), balls.get_vx() + n);
+	last_vy.assign(balls.get_vy(), balls.get_vy() + n);
+	last_r.assign(balls.get_radii(), balls.get_radii() + n);
+}
+
+//bins the bounding circle of each ball's path over the rest of its window, and empties the overflow lists
+void EventEngine::rebuild_grid(const BallSystem &balls, sf::FloatRect area)
+{
+	int n = balls.size();
+	int i;
+
+	swept_x.resize(n);
+	swept_y.resize(n);
+	swept_r.resize(n);
+
+	for (i = 0; i<n; i++)
+	{
+		sf::Vector2f half = (float)(window_end[i] - local_t[i]) / 2 * balls.get_velocity(i);
+		swept_x[i] = balls.get_position(i).x + half.x;
+		swept_y[i] = balls.get_position(i).y + half.y;
+		swept_r[i] = balls.get_radius(i) + magnitude(half);
+	}
+
+	//cells about the size of a typical swept path keep both the number of cells per ball
+	//and the number of balls per cell small
+	float total = 0;
+	for (i = 0; i<n; i++)
+		total += swept_r[i];
+	float cell = n>0 ? 2 * total / n : 2 * rDefault;
+
+	if (grid.get_area() != area) grid.set_area(area);
+	if (cell<grid.get_cell_size() / 2 || cell>grid.get_cell_size() * 2) grid.set_cell_size(cell);
+	if (n>0) grid.rebuild(&swept_x[0], &swept_y[0], &swept_r[0], n);
+	else grid.rebuild(0, 0, 0, 0);
+
+	overflow.resize(grid.get_cols() * grid.get_rows());
+	for (i = 0; i<(int)touched.size(); i++)
+		overflow[touched[i]].clear();
+	touched.clear();
+	num_overflow = 0;
+	dirty.assign(n, 0);
+}
+
+//records that ball i has a new path: its grid entry no longer covers it, so it is listed in the
+//overflow list of every cell the rest of its new window's path overlaps
+void EventEngine::mark_dirty(const BallSystem &balls, int i)
+{
+	sf::Vector2f pos = balls.get_position(i);
+	sf::Vector2f half = (float)(window_end[i] - local_t[i]) / 2 * balls.get_velocity(i);
+	float reach = balls.get_radius(i) + magnitude(half);
+	int sp[4], cx, cy;
+
+	dirty[i] = 1;
+	grid.get_cell_span(pos.x + half.x - reach, pos.y + half.y - reach, pos.x + half.x + reach, pos.y + half.y + reach, sp);
+
+	for (cy = sp[1]; cy <= sp[3]; cy++)
+	{
+		for (cx = sp[0]; cx <= sp[2]; cx++)
+		{
+			int c = cy*grid.get_cols() + cx;
+			if (overflow[c].empty()) touched.push_back(c);
+			overflow[c].push_back(i);
+			num_overflow++;
+		}
+	}
+}
+
+//queues an event with the current collision counts of the balls involved
+void EventEngine::push(double t, EventType type, int a, int b)
+{
+	CollisionEvent e;
+	e.t = t;
+	e.type = type;
+	e.a = a;
+	e.b = b;
+	e.count_a = counts[a];
+	e.count_b = type == BALL_EVENT ? counts[b] : 0;
+	queue.push(e);
+}
+
+//queues the collision of balls i and j, if they meet on their current paths before either window ends.
+//a later one is found when the ball whose window ends first is renewed
+void EventEngine::predict_pair(const BallSystem &balls, int i, int j)
+{
+	double t0 = local_t[i]>local_t[j] ? local_t[i] : local_t[j];
+	double t1 = window_end[i]<window_end[j] ? window_end[i] : window_end[j];
+	if (t1<t0) return;
+
+	sf::Vector2f pi = balls.get_position(i) + (float)(t0 - local_t[i]) * balls.get_velocity(i);
+	sf::Vector2f pj = balls.get_position(j) + (float)(t0 - local_t[j]) * balls.get_velocity(j);
+	float r = balls.get_radius(i) + balls.get_radius(j);
+	if (r>2 * CONTACT_SLOP) r -= CONTACT_SLOP;
+
+	float t = sweep_circle(pj - pi, balls.get_velocity(j) - balls.get_velocity(i), r, (float)(t1 - t0));
+	if (t >= 0) push(t0 + t, BALL_EVENT, i, j);
+}
+
+//queues every collision ball i will have before the end of its window if it keeps its current
+//velocity, and the renewal of the window. bvh may be null, in which case every wall is tested
+void EventEngine::predict(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, int i)
+{
+	sf::Vector2f pos = balls.get_position(i);
+	sf::Vector2f vel = balls.get_velocity(i);
+	float r = balls.get_radius(i);
+	float rest = (float)(window_end[i] - local_t[i]);
+	float t;
+	int k;
+
+	//other balls: clean ones from the grid, dirty ones from the overflow lists
+	sf::Vector2f half = rest / 2 * vel;
+	float reach = r + magnitude(half);
+	float left = pos.x + half.x - reach;
+	float top = pos.y + half.y - reach;
+	float right = pos.x + half.x + reach;
+	float bottom = pos.y + half.y + reach;
+	int sp[4], cx, cy;
+
+	found.clear();
+	grid.query(left, top, right, bottom, found);
+
+	for (k = 0; k<(int)found.size(); k++)
+	{
+		if (found[k] != i && !dirty[found[k]]) predict_pair(balls, i, found[k]);
+	}
+
+	if (++stamp == 0)
+	{
+		seen.assign(seen.size(), 0);
+		stamp = 1;
+	}
+	grid.get_cell_span(left, top, right, bottom, sp);
+
+	for (cy = sp[1]; cy <= sp[3]; cy++)
+	{
+		for (cx = sp[0]; cx <= sp[2]; cx++)
+		{
+			const std::vector<int> &extra = overflow[cy*grid.get_cols() + cx];
+
+			for (k = 0; k<(int)extra.size(); k++)
+			{
+				int j = extra[k];
+				if (j == i || seen[j] == stamp) continue;
+				seen[j] = stamp;
+				predict_pair(balls, i, j);
+			}
+		}
+	}
+
+	if (r>2 * CONTACT_SLOP) r -= CONTACT_SLOP;
+
+	if (bvh)
+	{
+		sf::Vector2f end = pos + rest * vel;
+		wall_candidates.clear();
+		bvh->query((pos.x<end.x ? pos.x : end.x) - r, (pos.y<end.y ? pos.y : end.y) - r,
+			(pos.x>end.x ? pos.x : end.x) + r, (pos.y>end.y ? pos.y : end.y) + r, wall_candidates);
+
+		for (k = 0; k<(int)wall_candidates.size(); k++)
+		{
+			t = sweep_wall(ws[wall_candidates[k]], pos, vel, r, rest);
+			if (t >= 0) push(local_t[i] + t, WALL_EVENT, i, wall_candidates[k]);
+		}
+	}
+	else
+	{
+		for (k = 0; k<num_walls; k++)
+		{
+			t = sweep_wall(ws[k], pos, vel, r, rest);
+			if (t >= 0) push(local_t[i] + t, WALL_EVENT, i, k);
+		}
+	}
+
+	bool x_side;
+	t = sweep_border(area, pos, vel, r, rest, x_side);
+	if (t >= 0) push(local_t[i] + t, x_side ? BORDER_X_EVENT : BORDER_Y_EVENT, i, 0);
+
+	push(window_end[i], RENEW_EVENT, i, 0);
+}
+
+//gives ball i, already moved to the time its path changed or its window ended, a new window from
+//there and predicts it again
+void EventEngine::repredict(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, int i)
+{
+	window_end[i] = local_t[i] + horizon;
+	mark_dirty(balls, i);
+	predict(balls, ws, num_walls, bvh, area, i);
+}
+
+//advances the argument balls by dt seconds, resolving every collision at the moment it happens.
+//collisions are resolved with the same formulas as the stepped engine (BallSystem::collide and
+//Ball::bounce_off_wall). if a ball takes part in more than MAX_EVENTS_PER_BALL collisions on average,
+//the rest of the interval is integrated without events and the regular border bounce is applied
+void EventEngine::advance(BallSystem &balls, const Wall *ws, int num_walls, sf::FloatRect area, float dt)
+{
+	advance(balls, ws, num_walls, 0, area, dt);
+}
+
+//same as above, with wall candidates taken from a BVH built over the argument walls
+void EventEngine::advance(BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, float dt)
+{
+	int n = balls.size();
+	long long budget = (long long)MAX_EVENTS_PER_BALL * n;
+	double end;
+	int i;
+
+	if (!started || n != (int)local_t.size() || area != last_area || dt != last_dt) start(balls, ws, num_walls, bvh, area, dt);
+	else catch_up(balls, ws, num_walls, bvh, area, dt);
+	end = now + dt;
+
+	while (!queue.empty() && queue.top().t <= end && budget>0)
+	{
+		CollisionEvent e = queue.top();
+		queue.pop();
+
+		if (e.count_a != counts[e.a]) continue;
+		if (e.type == BALL_EVENT && e.count_b != counts[e.b]) continue;
+
+		//bring the balls involved up to the time of the event and resolve it
+		balls.set_position(e.a, balls.get_position(e.a) + (float)(e.t - local_t[e.a]) * balls.get_velocity(e.a));
+		local_t[e.a] = e.t;
+
+		switch (e.type)
+		{
+		case BALL_EVENT:
+			balls.set_position(e.b, balls.get_position(e.b) + (float)(e.t - local_t[e.b]) * balls.get_velocity(e.b));
+			local_t[e.b] = e.t;
+			balls.collide(e.a, e.b);
+			break;
+
+		case WALL_EVENT:
+			balls.bounce_off_walls(e.a, ws, &e.b, 1);
+			break;
+
+		case BORDER_X_EVENT:
+			balls.bounce_off_border_x(e.a, area);
+			break;
+
+		case BORDER_Y_EVENT:
+			balls.bounce_off_border_y(e.a, area);
+			break;
+
+		case RENEW_EVENT:
+			//the path goes on unchanged, so its other events stay valid
+			repredict(balls, ws, num_walls, bvh, area, e.a);
+			continue;
+		}
+
+		num_events++;
+		budget--;
+
+		counts[e.a]++;
+		if (e.type == BALL_EVENT) counts[e.b]++;
+		repredict(balls, ws, num_walls, bvh, area, e.a);
+		if (e.type == BALL_EVENT) repredict(balls, ws, num_walls, bvh, area, e.b);
+	}
+
+	//every ball is moved to the end of the step; its path and so its predictions stay the same
+	for (i = 0; i<n; i++)
+	{
+		balls.set_position(i, balls.get_position(i) + (float)(end - local_t[i]) * balls.get_velocity(i));
+		local_t[i] = end;
+	}
+	now = end;
+
+	if (budget <= 0)
+	{
+		balls.bounce_off_border(area);
+		started = false;
+	}
+	save_state(balls);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <queue>
+#include <vector>
+#include "ball.h"
+#include "BallSystem.h"
+#include "Grid.h"
+#include "WallBVH.h"
+
+const int MAX_EVENTS_PER_BALL = 64;         //per advance() call, guards against balls wedged between others
+const int EVENT_HORIZON_STEPS = 32;         //steps ahead a ball's collisions are predicted before its window is renewed
+
+enum EventType { BALL_EVENT, WALL_EVENT, BORDER_X_EVENT, BORDER_Y_EVENT, RENEW_EVENT };
+
+//a predicted collision, or the end of a ball's prediction window (RENEW_EVENT).
+//it is stale, and skipped, if either ball has changed course since it was predicted
+struct CollisionEvent
+{
+	double t;               //engine time: seconds since the engine last started over
+	EventType type;
+	int a;                  //ball index
+	int b;                  //other ball or wall index, unused for the border and renewals
+	unsigned count_a;       //collision counts of a and b when the event was predicted
+	unsigned count_b;
+};
+
+//orders the queue so the earliest event is on top; ties are broken by the balls involved
+struct LaterEvent
+{
+	bool operator()(const CollisionEvent &e, const CollisionEvent &f) const;
+};
+
+//event-driven simulation: instead of testing for overlaps after fixed steps, predicts when each
+//ball next hits another ball, a wall or the border, keeps those events in a priority queue and
+//jumps straight from one collision to the next. events are invalidated lazily through
+//per-ball collision counts. each ball's collisions are predicted over a window of
+//EVENT_HORIZON_STEPS steps, and the predictions and the queue are kept from one advance() call to
+//the next: only balls that collided, reached the end of their window or were changed between calls
+//are predicted again, so the cost depends on the number of collisions rather than on the timestep.
+//every call still moves each ball to the end of the step and compares it with what it left, so balls
+//changed through the BallSystem are noticed. new balls, a new area or timestep, and reset() (for
+//changed walls) make it start over.
+//candidate neighbours come from a grid of the balls' swept paths over their windows. a ball whose
+//path changes is added to per-cell overflow lists along its new path, and the grid is only rebuilt
+//once those lists hold more entries than there are balls.
+//best for sparse, fast gases; dense scenes collide too often for this to beat the stepped engine
+class EventEngine
+{
+private:
+	std::priority_queue<CollisionEvent, std::vector<CollisionEvent>, LaterEvent> queue;
+
+	std::vector<double> local_t;        //time each ball was last moved to
+	std::vector<double> window_end;     //time up to which each ball's collisions have been predicted
+	std::vector<unsigned> counts;       //collisions of each ball so far
+	std::vector<unsigned char> dirty;   //path changed since the grid was built
+
+	Grid grid;
+	std::vector<std::vector<int> > overflow;    //per cell: dirty balls whose new path overlaps it
+	std::vector<int> touched;                   //cells with a nonempty overflow list
+	std::vector<unsigned> seen;                 //visit stamps, so each candidate is predicted once
+	unsigned stamp;
+	std::vector<float> swept_x;         //bounding circle of the rest of each ball's path
+	std::vector<float> swept_y;
+	std::vector<float> swept_r;
+	int num_overflow;                   //entries in the overflow lists
+	std::vector<int> found;
+	std::vector<int> wall_candidates;
+
+	bool started;                       //the queue holds every ball's predictions (see reset)
+	double now;                         //engine time at the end of the last advance() call
+	double horizon;                     //length of a prediction window
+	sf::FloatRect last_area;
+	float last_dt;
+	std::vector<float> last_x;          //the balls as the last advance() call left them
+	std::vector<float> last_y;
+	std::vector<float> last_vx;
+	std::vector<float> last_vy;
+	std::vector<float> last_r;
+	std::vector<int> changed;
+
+	long long num_events;
+
+	void start(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, float dt);
+	void catch_up(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, float dt);
+	void save_state(const BallSystem &balls);
+	void rebuild_grid(const BallSystem &balls, sf::FloatRect area);
+	void mark_dirty(const BallSystem &balls, int i);
+	void predict_pair(const BallSystem &balls, int i, int j);
+	void predict(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, int i);
+	void repredict(const BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, int i);
+	void push(double t, EventType type, int a, int b);
+
+public:
+	//Constructors
+	EventEngine();
+
+	//Getters
+	long long get_num_events() const            { return num_events; }
+
+	//Other functions
+	void reset()                                { started = false; }
+	void advance(BallSystem &balls, const Wall *ws, int num_walls, sf::FloatRect area, float dt);
+	void advance(BallSystem &balls, const Wall *ws, int num_walls, const WallBVH *bvh, sf::FloatRect area, float dt);
+};
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include "ForceField.h"
+
+//Default ForceField constructor - turned off
+ForceField::ForceField()
+{
+	*this = ForceField(0, THETA);
+}
+
+//Constructor
+ForceField::ForceField(float g)
+{
+	*this = ForceField(g, THETA);
+}
+
+//Primary constructor
+//allows only non-negative opening angles
+ForceField::ForceField(float g, float th)
+{
+	strength = g;
+	theta = THETA;
+	set_theta(th);
+}
+
+//allows only non-negative opening angles
+void ForceField::set_theta(float th)
+{
+	if (th<0) th = -th;
+	theta = th;
+}
+
+//rebuilds the quadtree over the current positions and masses of the argument balls
+void ForceField::build(const BallSystem &balls)
+{
+	int n = balls.size();
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	float left, top, right, bottom;
+	int i;
+
+	nodes.clear();
+	leaves.clear();
+	order.resize(n);
+	mass.resize(n);
+	if (n == 0) return;
+
+	left = right = x[0];
+	top = bottom = y[0];
+	for (i = 0; i<n; i++)
+	{
+		order[i] = i;
+		mass[i] = balls.get_inv_mass(i)<ZERO_MASS_INV ? 1 / balls.get_inv_mass(i) : 0;
+
+		if (x[i]<left) left = x[i];
+		if (x[i]>right) right = x[i];
+		if (y[i]<top) top = y[i];
+		if (y[i]>bottom) bottom = y[i];
+	}
+
+	QuadNode root;
+	root.left = left;
+	root.top = top;
+	root.size = std::max(right - left, bottom - top) * 1.0001f + 1e-3f;
+	root.first = 0;
+	root.count = n;
+	nodes.push_back(root);
+
+	build_node(0, x, y, 0);
+}
+
+//splits a node into quadrants, unless it is small enough to be a leaf, and sums up its mass
+void ForceField::build_node(int node, const float *x, const float *y, int depth)
+{
+	QuadNode nd = nodes[node];
+	int k, i;
+
+	nd.child = -1;
+	if (nd.count>QUAD_LEAF_SIZE && depth<MAX_QUAD_DEPTH)
+	{
+		int *b = &order[nd.first];
+		int *e = b + nd.count;
+		float mx = nd.left + nd.size / 2;
+		float my = nd.top + nd.size / 2;
+
+		//quadrants in the order (left, top), (right, top), (left, bottom), (right, bottom)
+		int *mid = std::partition(b, e, [&](int j) { return y[j]<my; });
+		int *q1 = std::partition(b, mid, [&](int j) { return x[j]<mx; });
+		int *q3 = std::partition(mid, e, [&](int j) { return x[j]<mx; });
+		int *split[5] = { b, q1, mid, q3, e };
+
+		nd.child = (int)nodes.size();
+		nodes.resize(nodes.size() + 4);
+		for (k = 0; k<4; k++)
+		{
+			QuadNode &c = nodes[nd.child + k];
+			c.size = nd.size / 2;
+			c.left = k & 1 ? mx : nd.left;
+			c.top = k & 2 ? my : nd.top;
+			c.first = (int)(split[k] - &order[0]);
+			c.count = (int)(split[k + 1] - split[k]);
+		}
+		for (k = 0; k<4; k++)
+			build_node(nd.child + k, x, y, depth + 1);
+	}
+
+	//centre of mass of the children, or of the balls of a leaf
+	float m = 0, sx = 0, sy = 0;
+	if (nd.child >= 0)
+	{
+		for (k = 0; k<4; k++)
+		{
+			const QuadNode &c = nodes[nd.child + k];
+			m += c.mass;
+			sx += c.mass * c.x;
+			sy += c.mass * c.y;
+		}
+	}
+	else
+	{
+		for (k = nd.first; k<nd.first + nd.count; k++)
+		{
+			i = order[k];
+			m += mass[i];
+			sx += mass[i] * x[i];
+			sy += mass[i] * y[i];
+		}
+	}
+	if (m>0)
+	{
+		nd.x = sx / m;
+		nd.y = sy / m;
+	}
+	else
+	{
+		nd.x = nd.left + nd.size / 2;
+		nd.y = nd.top + nd.size / 2;
+	}
+	nd.mass = m;
+	nodes[node] = nd;
+
+	if (nd.child<0 && nd.count>0) leaves.push_back(node);
+}
+
+//acceleration of ball i due to all the other balls, using the tree from the last build()
+sf::Vector2f ForceField::get_acceleration(const BallSystem &balls, int i) const
+{
+	int stack[3 * MAX_QUAD_DEPTH + 4];
+	int top = 0;
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	float px = x[i];
+	float py = y[i];
+	float eps2 = balls.get_radius(i) * balls.get_radius(i);
+	float th2 = theta * theta;
+	float ax = 0, ay = 0;
+	int k;
+
+	if (nodes.empty()) return sf::Vector2f(0, 0);
+	stack[top++] = 0;
+
+	while (top>0)
+	{
+		const QuadNode &nd = nodes[stack[--top]];
+		if (nd.mass <= 0) continue;
+
+		float dx = nd.x - px;
+		float dy = nd.y - py;
+		float d2 = dx*dx + dy*dy;
+
+		if (nd.child<0)
+		{
+			for (k = nd.first; k<nd.first + nd.count; k++)
+			{
+				int j = order[k];
+				if (j == i) continue;
+
+				float ex = x[j] - px;
+				float ey = y[j] - py;
+				float s2 = ex*ex + ey*ey + eps2;
+				float f = mass[j] / (s2 * sqrt(s2));
+				ax += f * ex;
+				ay += f * ey;
+			}
+		}
+		else if (nd.size * nd.size<th2 * d2)
+		{
+			float s2 = d2 + eps2;
+			float f = nd.mass / (s2 * sqrt(s2));
+			ax += f * dx;
+			ay += f * dy;
+		}
+		else
+		{
+			for (k = 0; k<4; k++)
+				stack[top++] = nd.child + k;
+		}
+	}
+
+	return strength * sf::Vector2f(ax, ay);
+}
+
+//adds dt times the acceleration of each ball in leaves first_leaf .. last_leaf - 1 to its velocity,
+//skipping balls i with frozen[i] set (frozen may be null). each leaf collects the nodes far enough
+//from its whole square to be summed as single bodies and the leaves that are too close, whose balls
+//are summed one by one. only reads positions, so disjoint ranges of leaves can be applied from
+//several threads at once
+void ForceField::apply(BallSystem &balls, int first_leaf, int last_leaf, float dt, const unsigned char *frozen) const
+{
+	int stack[3 * MAX_QUAD_DEPTH + 4];
+	std::vector<int> far_nodes;
+	std::vector<int> near_leaves;
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	float th2 = theta * theta;
+	int l, k, m;
+
+	for (l = first_leaf; l<last_leaf; l++)
+	{
+		const QuadNode &leaf = nodes[leaves[l]];
+		int top = 0;
+
+		far_nodes.clear();
+		near_leaves.clear();
+		stack[top++] = 0;
+		while (top>0)
+		{
+			int node = stack[--top];
+			const QuadNode &nd = nodes[node];
+			if (nd.mass <= 0) continue;
+
+			//distance from the centre of mass to the nearest point of the leaf's square
+			float dx = std::max(std::max(leaf.left - nd.x, nd.x - (leaf.left + leaf.size)), 0.0f);
+			float dy = std::max(std::max(leaf.top - nd.y, nd.y - (leaf.top + leaf.size)), 0.0f);
+
+			if (nd.child<0) near_leaves.push_back(node);
+			else if (nd.size * nd.size<th2 * (dx*dx + dy*dy)) far_nodes.push_back(node);
+			else
+			{
+				for (k = 0; k<4; k++)
+					stack[top++] = nd.child + k;
+			}
+		}
+
+		for (m = leaf.first; m<leaf.first + leaf.count; m++)
+		{
+			int i = order[m];
+			if (frozen && frozen[i]) continue;
+
+			float px = x[i];
+			float py = y[i];
+			float eps2 = balls.get_radius(i) * balls.get_radius(i);
+			float ax = 0, ay = 0;
+
+			for (k = 0; k<(int)far_nodes.size(); k++)
+			{
+				const QuadNode &nd = nodes[far_nodes[k]];
+				float dx = nd.x - px;
+				float dy = nd.y - py;
+				float s2 = dx*dx + dy*dy + eps2;
+				float f = nd.mass / (s2 * sqrt(s2));
+				ax += f * dx;
+				ay += f * dy;
+			}
+
+			for (k = 0; k<(int)near_leaves.size(); k++)
+			{
+				const QuadNode &nd = nodes[near_leaves[k]];
+				int q;
+
+				for (q = nd.first; q<nd.first + nd.count; q++)
+				{
+					int j = order[q];
+					if (j == i) continue;
+
+					float dx = x[j] - px;
+					float dy = y[j] - py;
+					float s2 = dx*dx + dy*dy + eps2;
+					float f = mass[j] / (s2 * sqrt(s2));
+					ax += f * dx;
+					ay += f * dy;
+				}
+			}
+
+			balls.set_velocity(i, balls.get_velocity(i) + dt * strength * sf::Vector2f(ax, ay));
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include "ball.h"
+#include "BallSystem.h"
+
+const float THETA = 0.5f;                   //default opening angle; 0 sums every pair exactly
+const int QUAD_LEAF_SIZE = 8;               //most balls stored in one leaf
+const int MAX_QUAD_DEPTH = 24;              //deeper nodes become leaves, so coincident balls cannot split forever
+
+//node of a ForceField quadtree. inner nodes have their four children at child .. child + 3;
+//leaves have child == -1 and list count balls starting at position first of the ball order
+struct QuadNode
+{
+	float x, y;                 //centre of mass, or of the square if the node is empty
+	float mass;
+	float left, top;            //square covered
+	float size;
+	int child;
+	int first;
+	int count;
+};
+
+//mutual attraction between all balls, approximated with a Barnes-Hut quadtree.
+//each ball i is accelerated by G * m_j * d / (|d|^2 + r_i^2)^(3/2) towards every other ball j, where d
+//points from i to j; the ball's own radius softens the force so it stays bounded when balls overlap.
+//a node of side s at distance |d| is treated as a single body at its centre of mass when
+//s < theta * |d|, so the cost per ball grows with log n for a fixed theta. apply() walks the tree
+//once per leaf rather than once per ball, measuring |d| from the nearest point of the leaf's square,
+//and shares the resulting interaction list between the balls of the leaf. a negative G repels
+class ForceField
+{
+private:
+	float strength;             //G, in pixels^3 / (mass * s^2); 0 turns the field off
+	float theta;
+
+	std::vector<QuadNode> nodes;
+	std::vector<int> order;             //ball indices, grouped by leaf
+	std::vector<int> leaves;            //nodes that are non-empty leaves
+	std::vector<float> mass;            //per ball; zero-mass balls attract nothing
+
+	void build_node(int node, const float *x, const float *y, int depth);
+
+public:
+	//Constructors
+	ForceField();
+	ForceField(float g);
+	ForceField(float g, float th);
+
+	//Getters
+	float get_strength() const              { return strength; }
+	float get_theta() const                 { return theta; }
+	int get_num_nodes() const               { return (int)nodes.size(); }
+	int get_num_leaves() const              { return (int)leaves.size(); }
+
+	//Setters
+	void set_strength(float g)              { strength = g; }
+	void set_theta(float th);
+
+	//Other functions
+	void build(const BallSystem &balls);
+	sf::Vector2f get_acceleration(const BallSystem &balls, int i) const;
+	void apply(BallSystem &balls, int first_leaf, int last_leaf, float dt, const unsigned char *frozen) const;
+};
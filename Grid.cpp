@@ -0,0 +1,217 @@
+#include "Grid.h"
+
+//Default Grid constructor
+Grid::Grid()
+{
+	*this = Grid(sf::FloatRect(0, 0, 800, 600), 2 * rDefault);
+}
+
+//Constructor - cells are sized to fit a ball of default radius
+Grid::Grid(sf::FloatRect a)
+{
+	*this = Grid(a, 2 * rDefault);
+}
+
+//Primary constructor
+//allows only positive values for the cell size
+Grid::Grid(sf::FloatRect a, float cell)
+{
+	area = a;
+
+	if (cell<0) cell = -cell;
+	if (cell == 0) cell = 2 * rDefault;
+	if (cell>2 * MAX_RADIUS) cell = 2 * MAX_RADIUS;
+	cell_size = cell;
+
+	update_dimensions();
+}
+
+//recomputes the number of rows and columns from the area and cell size.
+//must be called any time either of them is altered
+void Grid::update_dimensions()
+{
+	if (area.width<0) area.width = -area.width;
+	if (area.height<0) area.height = -area.height;
+
+	//grow the cells until the grid fits in MAX_GRID_CELLS
+	while ((double)(area.width / cell_size + 1) * (area.height / cell_size + 1) > MAX_GRID_CELLS)
+		cell_size *= 2;
+
+	cols = (int)(area.width / cell_size) + 1;
+	rows = (int)(area.height / cell_size) + 1;
+
+	cell_start.assign(cols*rows + 1, 0);
+}
+
+void Grid::set_area(sf::FloatRect a)
+{
+	area = a;
+	update_dimensions();
+}
+
+//allows only positive values for the cell size
+void Grid::set_cell_size(float cell)
+{
+	if (cell<0) cell = -cell;
+	if (cell == 0) cell = 2 * rDefault;
+	cell_size = cell;
+	update_dimensions();
+}
+
+//bins the balls of the argument array.
+//pair indices reported by find_pairs refer to positions in this array
+void Grid::rebuild(const Ball *bs, int n)
+{
+	std::vector<float> x(n), y(n), r(n);
+	int i;
+
+	for (i = 0; i<n; i++)
+	{
+		x[i] = bs[i].getx();
+		y[i] = bs[i].gety();
+		r[i] = bs[i].get_radius();
+	}
+
+	if (n>0) rebuild(&x[0], &y[0], &r[0], n);
+	else rebuild(0, 0, 0, 0);
+}
+
+//bins n balls given as separate coordinate and radius arrays
+void Grid::rebuild(const float *x, const float *y, const float *r, int n)
+{
+	int i, cx, cy;
+	int num_cells = cols*rows;
+
+	box.resize(4 * n);
+	span.resize(4 * n);
+	cell_start.assign(num_cells + 1, 0);
+
+	//find the range of cells each ball overlaps and count the balls in each cell
+	for (i = 0; i<n; i++)
+	{
+		float *bx = &box[4 * i];
+		int *sp = &span[4 * i];
+
+		bx[0] = x[i] - r[i];
+		bx[1] = y[i] - r[i];
+		bx[2] = x[i] + r[i];
+		bx[3] = y[i] + r[i];
+
+		//balls outside the area are kept in the border cells
+		get_cell_span(bx[0], bx[1], bx[2], bx[3], sp);
+
+		for (cy = sp[1]; cy <= sp[3]; cy++)
+			for (cx = sp[0]; cx <= sp[2]; cx++)
+				cell_start[cy*cols + cx + 1]++;
+	}
+
+	for (i = 0; i<num_cells; i++)
+		cell_start[i + 1] += cell_start[i];
+
+	//scatter ball indices into their cells
+	std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+	cell_items.resize(cell_start[num_cells]);
+
+	for (i = 0; i<n; i++)
+	{
+		const int *sp = &span[4 * i];
+
+		for (cy = sp[1]; cy <= sp[3]; cy++)
+			for (cx = sp[0]; cx <= sp[2]; cx++)
+				cell_items[fill[cy*cols + cx]++] = i;
+	}
+}
+
+//appends every pair of balls whose bounding boxes overlap to the argument vector.
+//a pair sharing several cells is reported only once, from the first cell the two
+//spans have in common. pairs are produced in a fixed order for a given input
+void Grid::find_pairs(std::vector<CandidatePair> &pairs) const
+{
+	find_pairs(pairs, 0, cols*rows);
+}
+
+//appends the pairs reported from cells first_cell up to (not including) last_cell.
+//splitting the cells into consecutive ranges and concatenating the results in range order
+//gives the same pairs in the same order as searching all cells at once
+void Grid::find_pairs(std::vector<CandidatePair> &pairs, int first_cell, int last_cell) const
+{
+	int c, k, l, i, j;
+
+	for (c = first_cell; c<last_cell; c++)
+	{
+		int first = cell_start[c];
+		int last = cell_start[c + 1];
+		int cx = c % cols;
+		int cy = c / cols;
+
+		for (k = first; k<last; k++)
+		{
+			i = cell_items[k];
+			const float *bi = &box[4 * i];
+			const int *si = &span[4 * i];
+
+			for (l = k + 1; l<last; l++)
+			{
+				j = cell_items[l];
+				const float *bj = &box[4 * j];
+				const int *sj = &span[4 * j];
+
+				//skip the pair if it was already reported from an earlier shared cell
+				if ((si[0]>sj[0] ? si[0] : sj[0]) != cx || (si[1]>sj[1] ? si[1] : sj[1]) != cy) continue;
+
+				if (bi[0] >= bj[2] || bj[0] >= bi[2] || bi[1] >= bj[3] || bj[1] >= bi[3]) continue;
+
+				CandidatePair p;
+				p.a = i;
+				p.b = j;
+				pairs.push_back(p);
+			}
+		}
+	}
+}
+
+//stores the first column, first row, last column and last row of the cells the argument box overlaps
+//in sp (clamped to the grid like the balls are) and returns the number of cells
+int Grid::get_cell_span(float left, float top, float right, float bottom, int *sp) const
+{
+	sp[0] = left<area.left ? 0 : (int)((left - area.left) / cell_size);
+	sp[1] = top<area.top ? 0 : (int)((top - area.top) / cell_size);
+	sp[2] = right<area.left ? 0 : (int)((right - area.left) / cell_size);
+	sp[3] = bottom<area.top ? 0 : (int)((bottom - area.top) / cell_size);
+	if (sp[0] >= cols) sp[0] = cols - 1;
+	if (sp[1] >= rows) sp[1] = rows - 1;
+	if (sp[2] >= cols) sp[2] = cols - 1;
+	if (sp[3] >= rows) sp[3] = rows - 1;
+
+	return (sp[2] - sp[0] + 1) * (sp[3] - sp[1] + 1);
+}
+
+//appends the index of every ball whose bounding box overlaps the argument box to the argument vector.
+//each ball is reported once, from the first cell its span shares with the box
+void Grid::query(float left, float top, float right, float bottom, std::vector<int> &found) const
+{
+	int q[4], cx, cy, k;
+
+	if (box.empty()) return;
+	get_cell_span(left, top, right, bottom, q);
+
+	for (cy = q[1]; cy <= q[3]; cy++)
+	{
+		for (cx = q[0]; cx <= q[2]; cx++)
+		{
+			int c = cy*cols + cx;
+
+			for (k = cell_start[c]; k<cell_start[c + 1]; k++)
+			{
+				int j = cell_items[k];
+				const float *bj = &box[4 * j];
+				const int *sj = &span[4 * j];
+
+				if ((q[0]>sj[0] ? q[0] : sj[0]) != cx || (q[1]>sj[1] ? q[1] : sj[1]) != cy) continue;
+				if (left >= bj[2] || bj[0] >= right || top >= bj[3] || bj[1] >= bottom) continue;
+
+				found.push_back(j);
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include "ball.h"
+
+const int MAX_GRID_CELLS = 1 << 22;         //cell size is enlarged if the area would need more cells than this
+
+//two balls whose bounding boxes overlap. a broad phase only produces candidates;
+//the narrow phase (is_colliding_with) still decides whether they actually collide
+struct CandidatePair
+{
+	int a;
+	int b;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//uniform grid broad phase.
+//every ball is binned into each cell its bounding box overlaps, so cells can be
+//smaller than the largest ball. balls outside the grid area are clamped into the border cells.
+//the grid is rebuilt from scratch with a counting sort, which is cheap enough to do every step
+class Grid
+{
+private:
+	sf::FloatRect area;
+	float cell_size;            // > 0
+	int cols;
+	int rows;
+
+	std::vector<int> cell_start;    //cols*rows + 1 offsets into cell_items
+	std::vector<int> cell_items;    //ball indices grouped by cell
+
+	std::vector<float> box;         //4 floats per ball: left, top, right, bottom
+	std::vector<int> span;          //4 ints per ball: first col, first row, last col, last row
+
+	void update_dimensions();
+
+public:
+	//Constructors
+	Grid();
+	Grid(sf::FloatRect a);
+	Grid(sf::FloatRect a, float cell);
+
+	//Getters
+	sf::FloatRect get_area() const          { return area; }
+	float get_cell_size() const             { return cell_size; }
+	int get_cols() const                    { return cols; }
+	int get_rows() const                    { return rows; }
+
+	//Setters
+	void set_area(sf::FloatRect a);
+	void set_cell_size(float cell);
+
+	//Other functions
+	void rebuild(const Ball *bs, int n);
+	void rebuild(const float *x, const float *y, const float *r, int n);
+	void find_pairs(std::vector<CandidatePair> &pairs) const;
+	void find_pairs(std::vector<CandidatePair> &pairs, int first_cell, int last_cell) const;
+	int get_cell_span(float left, float top, float right, float bottom, int *sp) const;
+	void query(float left, float top, float right, float bottom, std::vector<int> &found) const;
+};
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include "Morton.h"
+
+//spreads the low 16 bits of v to the even bits of the result
+static uint32_t spread_bits(uint32_t v)
+{
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+//Z-order (Morton) key of a cell: the bits of x and y interleaved, x in the even bits.
+//cells close together in the plane mostly get keys close together
+uint32_t morton_key(uint32_t x, uint32_t y)
+{
+	return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+//sorts keys in increasing order and applies the same reordering to values. the sort is stable,
+//so equal keys keep their order. a least-significant-digit radix sort: every pass counts the digits
+//of each block of keys, then scatters each block to its own precomputed offsets, so the blocks can
+//be handled by different threads of the pool (which may be null). passes in which every key has
+//the same digit are skipped
+void radix_sort(std::vector<uint32_t> &keys, std::vector<int> &values, ThreadPool *pool)
+{
+	int n = (int)keys.size();
+	int blocks = pool ? pool->get_num_threads() : 1;
+	int shift, d, b;
+
+	if (blocks>n / MIN_RADIX_BLOCK) blocks = n / MIN_RADIX_BLOCK;
+	if (blocks<1) blocks = 1;
+
+	std::vector<uint32_t> sorted_keys(n);
+	std::vector<int> sorted_values(n);
+	std::vector<int> offsets(blocks * RADIX_BUCKETS);      //by block, then digit
+
+	//runs fn over the blocks, on the pool if there is more than one
+	auto for_blocks = [&](const std::function<void(int, int)> &fn)
+	{
+		if (pool && blocks>1) pool->parallel_for(blocks, 1, fn);
+		else fn(0, blocks);
+	};
+
+	for (shift = 0; shift<32; shift += RADIX_BITS)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+
+		for_blocks([&](int first, int last)
+		{
+			for (int b = first; b<last; b++)
+			{
+				int *count = &offsets[b * RADIX_BUCKETS];
+				for (int i = (int)((long long)n * b / blocks); i<(int)((long long)n * (b + 1) / blocks); i++)
+					count[keys[i] >> shift & (RADIX_BUCKETS - 1)]++;
+			}
+		});
+
+		//turn the counts into the position each block writes its first key of each digit to.
+		//all keys with a lower digit come first, then those of the same digit in earlier blocks
+		int total = 0;
+		bool one_digit = false;
+		for (d = 0; d<RADIX_BUCKETS; d++)
+		{
+			int before = total;
+			for (b = 0; b<blocks; b++)
+			{
+				int c = offsets[b * RADIX_BUCKETS + d];
+				offsets[b * RADIX_BUCKETS + d] = total;
+				total += c;
+			}
+			if (total - before == n) one_digit = true;
+		}
+		if (one_digit) continue;
+
+		for_blocks([&](int first, int last)
+		{
+			for (int b = first; b<last; b++)
+			{
+				int *next = &offsets[b * RADIX_BUCKETS];
+				for (int i = (int)((long long)n * b / blocks); i<(int)((long long)n * (b + 1) / blocks); i++)
+				{
+					int slot = next[keys[i] >> shift & (RADIX_BUCKETS - 1)]++;
+					sorted_keys[slot] = keys[i];
+					sorted_values[slot] = values[i];
+				}
+			}
+		});
+
+		keys.swap(sorted_keys);
+		values.swap(sorted_values);
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ThreadPool.h"
+
+const int MORTON_BITS = 16;                 //bits of each coordinate in a key
+const int RADIX_BITS = 11;                  //key bits sorted per radix pass
+const int RADIX_BUCKETS = 1 << RADIX_BITS;
+const int MIN_RADIX_BLOCK = 4096;           //fewest keys a thread counts and scatters on its own
+
+uint32_t morton_key(uint32_t x, uint32_t y);
+void radix_sort(std::vector<uint32_t> &keys, std::vector<int> &values, ThreadPool *pool);
@@ -0,0 +1,111 @@
+#include "PhysicsThread.h"
+
+//Constructor
+//the thread is not started until start() is called
+PhysicsThread::PhysicsThread(World &w)
+{
+	world = &w;
+	running = false;
+	start_time = std::chrono::steady_clock::now();
+}
+
+PhysicsThread::~PhysicsThread()
+{
+	stop();
+}
+
+//seconds since the thread was started, on the clock the physics steps are scheduled by
+double PhysicsThread::get_time() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+//fraction of the way from the previous positions in s to the current ones that should be drawn now.
+//the step that produced s is drawn over the following dt, so the picture lags physics by one step
+float PhysicsThread::get_interpolation(const Snapshot &s) const
+{
+	if (s.dt <= 0) return 1;
+
+	float a = (float)((get_time() - s.time) / s.dt);
+
+	if (a<0) a = 0;
+	if (a>1) a = 1;
+	return a;
+}
+
+//publishes the initial state and starts stepping. does nothing if already running
+void PhysicsThread::start()
+{
+	if (running) return;
+
+	const BallSystem &balls = world->get_balls();
+
+	prev_x.assign(balls.get_x(), balls.get_x() + balls.size());
+	prev_y.assign(balls.get_y(), balls.get_y() + balls.size());
+	take_snapshot(*world, prev_x.empty() ? 0 : &prev_x[0], prev_y.empty() ? 0 : &prev_y[0], 0, buffer.get_back());
+	buffer.publish();
+
+	start_time = std::chrono::steady_clock::now();
+	running = true;
+	thread = std::thread(&PhysicsThread::run, this);
+}
+
+//waits for the current batch of steps to finish; the world can be used directly again afterwards
+void PhysicsThread::stop()
+{
+	running = false;
+	if (thread.joinable()) thread.join();
+}
+
+//moves the previous positions along with the balls after the world sorted them
+void PhysicsThread::reorder_previous()
+{
+	const int *order = world->get_sort_order();
+	int n = (int)prev_x.size();
+	std::vector<float> x(n), y(n);
+	int k;
+
+	for (k = 0; k<n; k++)
+	{
+		x[k] = prev_x[order[k]];
+		y[k] = prev_y[order[k]];
+	}
+	prev_x.swap(x);
+	prev_y.swap(y);
+}
+
+//steps the world whenever a step falls due by the clock, then sleeps until the next one.
+//like World::step, at most MAX_STEPS_PER_CALL steps are run in a row; time beyond that is dropped
+void PhysicsThread::run()
+{
+	double dt = world->get_fixed_dt();
+	double sim_time = 0;            //simulated time, kept equal to the clock as long as physics keeps up
+	int steps;
+
+	while (running)
+	{
+		double now = get_time();
+
+		for (steps = 0; sim_time + dt <= now && steps<MAX_STEPS_PER_CALL; steps++)
+		{
+			const BallSystem &balls = world->get_balls();
+
+			prev_x.assign(balls.get_x(), balls.get_x() + balls.size());
+			prev_y.assign(balls.get_y(), balls.get_y() + balls.size());
+
+			world->tick();
+			if (world->is_reordered()) reorder_previous();
+			sim_time += dt;
+		}
+
+		if (steps == MAX_STEPS_PER_CALL && sim_time + dt <= now) sim_time = now;
+
+		if (steps>0)
+		{
+			take_snapshot(*world, prev_x.empty() ? 0 : &prev_x[0], prev_y.empty() ? 0 : &prev_y[0], sim_time, buffer.get_back());
+			buffer.publish();
+		}
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(sim_time + dt - get_time()));
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "World.h"
+#include "Snapshot.h"
+
+//runs a world on its own thread at its fixed timestep and publishes a snapshot after every batch
+//of steps, so drawing and physics overlap instead of delaying each other.
+//while the thread runs it owns the world: other threads should only read snapshots
+class PhysicsThread
+{
+private:
+	World *world;
+	SnapshotBuffer buffer;
+	std::thread thread;
+	std::atomic<bool> running;
+	std::chrono::steady_clock::time_point start_time;
+
+	std::vector<float> prev_x;      //ball positions before the latest step
+	std::vector<float> prev_y;
+
+	void run();
+	void reorder_previous();
+
+	PhysicsThread(const PhysicsThread &);
+	PhysicsThread &operator=(const PhysicsThread &);
+
+public:
+	//Constructors
+	PhysicsThread(World &w);
+	~PhysicsThread();
+
+	//Getters
+	bool is_running() const                     { return running; }
+	double get_time() const;
+	float get_interpolation(const Snapshot &s) const;
+
+	//Other functions
+	void start();
+	void stop();
+	bool acquire()                              { return buffer.acquire(); }
+	const Snapshot &get_snapshot() const        { return buffer.get_front(); }
+};
@@ -0,0 +1,162 @@
+#include <cstdio>
+#include "Profiler.h"
+
+//Default Profiler constructor
+Profiler::Profiler()
+{
+	reset();
+}
+
+//returns the profiler shared by the whole program
+Profiler &get_profiler()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+const char *get_phase_name(Phase p)
+{
+	switch (p)
+	{
+	case INTEGRATE_PHASE: return "integrate";
+	case BORDER_PHASE: return "border";
+	case BALL_PHASE: return "ball_ball";
+	case WALL_PHASE: return "ball_wall";
+	case FORCE_PHASE: return "force";
+	case RENDER_PHASE: return "render";
+	default: return "unknown";
+	}
+}
+
+const char *get_counter_name(Counter c)
+{
+	switch (c)
+	{
+	case PAIR_TESTS: return "pair_tests";
+	case OVERLAPS: return "overlaps";
+	case STUTTER_REJECTS: return "stutter_rejects";
+	case WALL_CORNER_BOUNCES: return "wall_corner_bounces";
+	case WALL_EDGE_BOUNCES: return "wall_edge_bounces";
+	case WALL_FACE_BOUNCES: return "wall_face_bounces";
+	default: return "unknown";
+	}
+}
+
+//closes the current frame: its values become the ones returned by the getters and are added to the totals
+void Profiler::end_frame()
+{
+	int i;
+
+	for (i = 0; i<NUM_PHASES; i++)
+	{
+		last_phase_ns[i] = phase_ns[i].exchange(0);
+		total_phase_ns[i] += last_phase_ns[i];
+	}
+	for (i = 0; i<NUM_COUNTERS; i++)
+	{
+		last_counters[i] = counters[i].exchange(0);
+		total_counters[i] += last_counters[i];
+	}
+	frames++;
+}
+
+//clears the current frame, the last frame and the totals
+void Profiler::reset()
+{
+	int i;
+
+	for (i = 0; i<NUM_PHASES; i++)
+	{
+		phase_ns[i] = 0;
+		last_phase_ns[i] = 0;
+		total_phase_ns[i] = 0;
+	}
+	for (i = 0; i<NUM_COUNTERS; i++)
+	{
+		counters[i] = 0;
+		last_counters[i] = 0;
+		total_counters[i] = 0;
+	}
+	frames = 0;
+}
+
+//writes the column names matching write_csv_row
+void Profiler::write_csv_header(std::ostream &out) const
+{
+	int i;
+
+	out << "frame";
+	for (i = 0; i<NUM_PHASES; i++)
+		out << "," << get_phase_name((Phase)i) << "_ms";
+	for (i = 0; i<NUM_COUNTERS; i++)
+		out << "," << get_counter_name((Counter)i);
+	out << "\n";
+}
+
+//writes the last completed frame as one CSV line
+void Profiler::write_csv_row(std::ostream &out) const
+{
+	int i;
+
+	out << frames;
+	for (i = 0; i<NUM_PHASES; i++)
+		out << "," << get_phase_ms((Phase)i);
+	for (i = 0; i<NUM_COUNTERS; i++)
+		out << "," << last_counters[i];
+	out << "\n";
+}
+
+//writes the last completed frame and the totals as a JSON object
+void Profiler::write_json(std::ostream &out) const
+{
+	int i;
+
+	out << "{\"frames\":" << frames << ",\"last\":{";
+	for (i = 0; i<NUM_PHASES; i++)
+		out << "\"" << get_phase_name((Phase)i) << "_ms\":" << get_phase_ms((Phase)i) << ",";
+	for (i = 0; i<NUM_COUNTERS; i++)
+		out << "\"" << get_counter_name((Counter)i) << "\":" << last_counters[i] << (i + 1<NUM_COUNTERS ? "," : "");
+	out << "},\"total\":{";
+	for (i = 0; i<NUM_PHASES; i++)
+		out << "\"" << get_phase_name((Phase)i) << "_ms\":" << get_total_phase_ms((Phase)i) << ",";
+	for (i = 0; i<NUM_COUNTERS; i++)
+		out << "\"" << get_counter_name((Counter)i) << "\":" << total_counters[i] << (i + 1<NUM_COUNTERS ? "," : "");
+	out << "}}\n";
+}
+
+//draws one bar per phase in the top left corner, 1 pixel per 0.1 ms of the last frame.
+//if a font is given, each bar is labelled and the counters are listed below
+void Profiler::draw_overlay(sf::RenderTarget &target, const sf::Font *font) const
+{
+	const sf::Color colors[NUM_PHASES] = { sf::Color::Green, sf::Color::Yellow, sf::Color::Red, sf::Color::Magenta, sf::Color::Cyan, sf::Color::White };
+	char line[96];
+	int i;
+
+	for (i = 0; i<NUM_PHASES; i++)
+	{
+		sf::RectangleShape bar(sf::Vector2f((float)(get_phase_ms((Phase)i) * 10), 10));
+		bar.setPosition(12, 12 + 14.0f * i);
+		bar.setFillColor(colors[i]);
+		target.draw(bar);
+
+		if (font)
+		{
+			sprintf(line, "%s %.2f ms", get_phase_name((Phase)i), get_phase_ms((Phase)i));
+			sf::Text label(line, *font, 10);
+			label.setPosition(16, 10 + 14.0f * i);
+			label.setFillColor(sf::Color::Black);
+			target.draw(label);
+		}
+	}
+
+	if (!font) return;
+
+	for (i = 0; i<NUM_COUNTERS; i++)
+	{
+		sprintf(line, "%s %lld", get_counter_name((Counter)i), last_counters[i]);
+		sf::Text label(line, *font, 10);
+		label.setPosition(12, 12 + 14.0f * (NUM_PHASES + i));
+		label.setFillColor(sf::Color::White);
+		target.draw(label);
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <SFML/Graphics.hpp>
+
+//instrumentation is compiled in only when BALL_PROFILING is defined; otherwise the PROFILE_ macros
+//below expand to nothing and the Profiler reports zeros, so they can stay in production code
+
+enum Phase { INTEGRATE_PHASE, BORDER_PHASE, BALL_PHASE, WALL_PHASE, FORCE_PHASE, RENDER_PHASE, NUM_PHASES };
+
+enum Counter
+{
+	PAIR_TESTS,                 //ball-ball overlap tests
+	OVERLAPS,                   //tests that found an overlap
+	STUTTER_REJECTS,            //collisions skipped by STUTTER_PROTECTION (balls or walls)
+	WALL_CORNER_BOUNCES,        //bounce_off_wall outcomes
+	WALL_EDGE_BOUNCES,
+	WALL_FACE_BOUNCES,
+	NUM_COUNTERS
+};
+
+//per-phase times and event counters for the simulation step.
+//values accumulate until end_frame(), which makes them available through the getters and adds them
+//to the running totals. safe to update from several threads at once
+class Profiler
+{
+private:
+	std::atomic<long long> phase_ns[NUM_PHASES];        //current frame
+	std::atomic<long long> counters[NUM_COUNTERS];
+
+	long long last_phase_ns[NUM_PHASES];                //last completed frame
+	long long last_counters[NUM_COUNTERS];
+	long long total_phase_ns[NUM_PHASES];               //all completed frames
+	long long total_counters[NUM_COUNTERS];
+	long long frames;
+
+public:
+	//Constructors
+	Profiler();
+
+	//Getters
+	double get_phase_ms(Phase p) const              { return last_phase_ns[p] / 1e6; }
+	double get_total_phase_ms(Phase p) const        { return total_phase_ns[p] / 1e6; }
+	long long get_count(Counter c) const            { return last_counters[c]; }
+	long long get_total_count(Counter c) const      { return total_counters[c]; }
+	long long get_num_frames() const                { return frames; }
+
+	//Other functions
+	void add_time(Phase p, long long ns)            { phase_ns[p].fetch_add(ns, std::memory_order_relaxed); }
+	void count(Counter c, long long n)              { counters[c].fetch_add(n, std::memory_order_relaxed); }
+	void end_frame();
+	void reset();
+
+	void write_csv_header(std::ostream &out) const;
+	void write_csv_row(std::ostream &out) const;
+	void write_json(std::ostream &out) const;
+	void draw_overlay(sf::RenderTarget &target, const sf::Font *font) const;
+};
+
+const char *get_phase_name(Phase p);
+const char *get_counter_name(Counter c);
+
+Profiler &get_profiler();
+
+//adds the time from its construction to its destruction to a phase
+class PhaseTimer
+{
+private:
+	Phase phase;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	PhaseTimer(Phase p) : phase(p), start(std::chrono::steady_clock::now()) {}
+	~PhaseTimer()
+	{
+		get_profiler().add_time(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+};
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+
+#ifdef BALL_PROFILING
+#define PROFILE_PHASE(p) PhaseTimer PROFILE_JOIN(phase_timer_, __LINE__)(p)      //times the rest of the enclosing block
+#define PROFILE_COUNT(c, n) get_profiler().count(c, n)
+#define PROFILE_END_FRAME() get_profiler().end_frame()
+#else
+#define PROFILE_PHASE(p)
+#define PROFILE_COUNT(c, n) ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+#endif
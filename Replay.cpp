@@ -0,0 +1,583 @@
+#include <cmath>
+#include <cstring>
+#include "Replay.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char REPLAY_MAGIC[8] = "BALLRPL";
+const char INDEX_MAGIC[8] = "BALLIDX";
+
+//appends n values to the byte buffer
+template <class T>
+void put(std::vector<char> &buf, const T *p, int n)
+{
+	size_t at = buf.size();
+
+	buf.resize(at + n * sizeof(T));
+	if (n>0) memcpy(&buf[at], p, n * sizeof(T));
+}
+
+//copies n values out of a mapped frame and advances the read pointer past them
+template <class T>
+void get(const unsigned char *&p, T *out, int n)
+{
+	if (n>0) memcpy(out, p, n * sizeof(T));
+	p += n * sizeof(T);
+}
+
+//copies the argument world into f. prev_x and prev_y are set to the current positions.
+//balls are stored in id order, so each ball keeps its place in every frame however the world sorts them
+void take_replay_frame(const World &world, ReplayFrame &f)
+{
+	const BallSystem &balls = world.get_balls();
+	const int *index = balls.get_indices();
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	const float *u = balls.get_vx();
+	const float *v = balls.get_vy();
+	int n = balls.size();
+	int id;
+
+	f.step = world.get_step_count();
+	f.time = world.get_step_count() * (double)world.get_fixed_dt();
+	f.dt = world.get_fixed_dt();
+	f.area = world.get_area();
+
+	f.x.resize(n);
+	f.y.resize(n);
+	f.radius.resize(n);
+	f.color.resize(n);
+	f.vx.resize(n);
+	f.vy.resize(n);
+	f.density.resize(n);
+	for (id = 0; id<n; id++)
+	{
+		int i = index[id];
+		f.x[id] = x[i];
+		f.y[id] = y[i];
+		f.radius[id] = balls.get_radius(i);
+		f.color[id] = balls.get_color(i);
+		f.vx[id] = u[i];
+		f.vy[id] = v[i];
+		f.density[id] = balls.get_density(i);
+	}
+	f.prev_x = f.x;
+	f.prev_y = f.y;
+
+	f.walls.assign(world.get_walls(), world.get_walls() + world.get_num_walls());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Default Recorder constructor
+//nothing is recorded until open() is called
+Recorder::Recorder()
+{
+	file = 0;
+	file_pos = 0;
+	stopping = false;
+	blocking = false;
+	recorded = 0;
+	dropped = 0;
+	since_key = 0;
+	memset(&header, 0, sizeof(header));
+}
+
+Recorder::~Recorder()
+{
+	close();
+}
+
+//creates the replay file at the argument path and writes its header. flags is 0 or REPLAY_DELTA.
+//returns false if the file cannot be created. a recorder that is already open is closed first
+bool Recorder::open(const char *path, const World &world, uint32_t flags)
+{
+	close();
+
+	file = fopen(path, "wb");
+	if (!file) return false;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, REPLAY_MAGIC, 8);
+	header.version = REPLAY_VERSION;
+	header.flags = flags;
+	header.fixed_dt = world.get_fixed_dt();
+	header.area[0] = world.get_area().left;
+	header.area[1] = world.get_area().top;
+	header.area[2] = world.get_area().width;
+	header.area[3] = world.get_area().height;
+	header.position_step = REPLAY_POSITION_STEP;
+	header.velocity_step = REPLAY_VELOCITY_STEP;
+	header.key_interval = KEY_FRAME_INTERVAL;
+
+	fwrite(&header, sizeof(header), 1, file);
+	file_pos = sizeof(header);
+	offsets.clear();
+	quantized.clear();
+	since_key = 0;
+	recorded = 0;
+	dropped = 0;
+	stopping = false;
+
+	writer = std::thread(&Recorder::work, this);
+	return true;
+}
+
+//queues a copy of the current state of the world for writing. does nothing if the recorder is not open
+void Recorder::record(const World &world)
+{
+	ReplayFrame *f;
+
+	if (!file) return;
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+
+		if (blocking && spare.empty() && (int)frames.size() >= MAX_PENDING_FRAMES)
+			written.wait(guard, [this] { return !spare.empty(); });
+
+		if (!spare.empty())
+		{
+			f = spare.back();
+			spare.pop_back();
+		}
+		else if ((int)frames.size()<MAX_PENDING_FRAMES)
+		{
+			frames.push_back(std::unique_ptr<ReplayFrame>(new ReplayFrame));
+			f = frames.back().get();
+		}
+		else
+		{
+			dropped++;
+			return;
+		}
+	}
+
+	//the frame belongs to this thread until it is queued, so it is filled without holding the lock
+	take_replay_frame(world, *f);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending.push_back(f);
+		recorded++;
+	}
+	wake.notify_one();
+}
+
+//writes out every queued frame, then the index and footer, and closes the file
+void Recorder::close()
+{
+	if (!file) return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	writer.join();
+
+	ReplayFooter footer;
+	footer.index_offset = file_pos;
+	footer.num_frames = offsets.size();
+	memcpy(footer.magic, INDEX_MAGIC, 8);
+
+	if (!offsets.empty()) fwrite(&offsets[0], sizeof(uint64_t), offsets.size(), file);
+	fwrite(&footer, sizeof(footer), 1, file);
+	fclose(file);
+	file = 0;
+}
+
+//writer thread: encodes and writes queued frames in order until the recorder is closed and the queue is empty
+void Recorder::work()
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	while (true)
+	{
+		wake.wait(guard, [this] { return stopping || !pending.empty(); });
+		if (pending.empty()) return;
+
+		ReplayFrame *f = pending.front();
+		pending.pop_front();
+
+		guard.unlock();
+		write_frame(*f);
+		guard.lock();
+
+		spare.push_back(f);
+		written.notify_one();
+	}
+}
+
+//encodes one frame into the file. a delta frame is written when the replay allows them, a key frame
+//was written less than KEY_FRAME_INTERVAL frames ago, the number of balls has not changed and at most
+//one value in 16 needs an escape; otherwise a key frame is written
+void Recorder::write_frame(const ReplayFrame &f)
+{
+	int n = (int)f.x.size();
+	int nw = (int)f.walls.size();
+	const float *src[4] = { n ? &f.x[0] : 0, n ? &f.y[0] : 0, n ? &f.vx[0] : 0, n ? &f.vy[0] : 0 };
+	float step[4] = { header.position_step, header.position_step, header.velocity_step, header.velocity_step };
+	bool delta = (header.flags & REPLAY_DELTA) && since_key + 1<(int)header.key_interval && (int)quantized.size() == 4 * n;
+	int c, i;
+
+	next_quantized.resize(4 * n);
+	differences.resize(4 * n);
+	escapes.clear();
+	for (c = 0; c<4; c++)
+	{
+		for (i = 0; i<n; i++)
+		{
+			int k = c*n + i;
+			int32_t q = (int32_t)lrintf(src[c][i] / step[c]);
+
+			next_quantized[k] = q;
+			if (!delta) continue;
+
+			if (q - quantized[k]>32767 || q - quantized[k] <= DELTA_ESCAPE)
+			{
+				DeltaEscape e = { (uint32_t)k, q };
+				escapes.push_back(e);
+				differences[k] = DELTA_ESCAPE;
+			}
+			else differences[k] = (int16_t)(q - quantized[k]);
+		}
+	}
+	if (16 * (int)escapes.size()>4 * n) delta = false;
+
+	ReplayFrameHeader fh;
+	fh.size = 0;
+	fh.type = delta ? DELTA_FRAME : KEY_FRAME;
+	fh.step = f.step;
+	fh.num_balls = n;
+	fh.num_walls = nw;
+
+	buffer.clear();
+	put(buffer, &fh, 1);
+
+	for (i = 0; i<nw; i++)
+	{
+		WallRecord r = make_wall_record(f.walls[i]);
+		put(buffer, &r, 1);
+	}
+
+	if (delta)
+	{
+		uint32_t num_escapes = (uint32_t)escapes.size();
+
+		put(buffer, n ? &differences[0] : (int16_t *)0, 4 * n);
+		put(buffer, &num_escapes, 1);
+		put(buffer, escapes.empty() ? (DeltaEscape *)0 : &escapes[0], (int)num_escapes);
+		since_key++;
+	}
+	else
+	{
+		for (c = 0; c<4; c++)
+			put(buffer, src[c], n);
+		put(buffer, n ? &f.radius[0] : (float *)0, n);
+		put(buffer, n ? &f.density[0] : (float *)0, n);
+		put(buffer, n ? &f.color[0] : (sf::Color *)0, n);
+		since_key = 0;
+	}
+	quantized.swap(next_quantized);
+
+	fh.size = (uint32_t)buffer.size();
+	memcpy(&buffer[0], &fh, sizeof(fh));
+
+	fwrite(&buffer[0], 1, buffer.size(), file);
+	offsets.push_back(file_pos);
+	file_pos += buffer.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Default Player constructor
+//nothing can be played until open() is called
+Player::Player()
+{
+	data = 0;
+	size = 0;
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+#else
+	fd = -1;
+#endif
+	current_index = -1;
+	memset(&header, 0, sizeof(header));
+}
+
+Player::~Player()
+{
+	close();
+}
+
+sf::FloatRect Player::get_area() const
+{
+	return sf::FloatRect(header.area[0], header.area[1], header.area[2], header.area[3]);
+}
+
+//maps the whole file at the argument path read-only. returns false if it cannot be opened or is empty
+bool Player::map(const char *path)
+{
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER len;
+	if (!GetFileSizeEx(file, &len) || len.QuadPart == 0) return false;
+	size = (size_t)len.QuadPart;
+
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping) return false;
+
+	data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	return data != 0;
+#else
+	struct stat st;
+
+	fd = ::open(path, O_RDONLY);
+	if (fd<0) return false;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) return false;
+	size = (size_t)st.st_size;
+
+	void *p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) return false;
+
+	data = (const unsigned char *)p;
+	return true;
+#endif
+}
+
+//unmaps the file
+void Player::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = 0;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void *)data, size);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+	data = 0;
+	size = 0;
+	offsets.clear();
+	current_index = -1;
+}
+
+//reads the index table through the footer or, for a file that was not closed properly,
+//by walking the frames from the start. returns false if a frame runs past the end of the file
+bool Player::read_index()
+{
+	ReplayFooter footer;
+	uint64_t pos;
+
+	offsets.clear();
+
+	if (size >= sizeof(header) + sizeof(footer))
+	{
+		memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+		if (memcmp(footer.magic, INDEX_MAGIC, 8) == 0 &&
+			footer.index_offset + footer.num_frames * sizeof(uint64_t) + sizeof(footer) == size)
+		{
+			offsets.resize((size_t)footer.num_frames);
+			if (!offsets.empty()) memcpy(&offsets[0], data + footer.index_offset, offsets.size() * sizeof(uint64_t));
+			return true;
+		}
+	}
+
+	for (pos = sizeof(header); pos + sizeof(ReplayFrameHeader) <= size;)
+	{
+		ReplayFrameHeader fh;
+		memcpy(&fh, data + pos, sizeof(fh));
+		if (fh.type != KEY_FRAME && fh.type != DELTA_FRAME) break;
+		if (fh.size<sizeof(fh) + fh.num_walls * sizeof(WallRecord) + fh.num_balls * (fh.type == KEY_FRAME ? 6 * sizeof(float) + sizeof(sf::Color) : 4 * sizeof(int16_t)) ||
+			pos + fh.size>size) break;
+
+		offsets.push_back(pos);
+		pos += fh.size;
+	}
+	return true;
+}
+
+//opens and maps the replay file at the argument path. returns false if it cannot be read,
+//is not a replay or was written by a different version of the format
+bool Player::open(const char *path)
+{
+	close();
+
+	if (!map(path) || size<sizeof(header))
+	{
+		close();
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, REPLAY_MAGIC, 8) != 0 || header.version != REPLAY_VERSION || !read_index())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+//type of frame f. frames are not aligned in the file, so headers are copied out rather than cast
+uint32_t Player::get_frame_type(int f) const
+{
+	ReplayFrameHeader fh;
+
+	memcpy(&fh, data + offsets[f], sizeof(fh));
+	return fh.type;
+}
+
+//decodes frame f into current. a delta frame needs current to hold frame f - 1.
+//the positions current held before become prev_x and prev_y
+void Player::decode(int f)
+{
+	ReplayFrameHeader fh;
+	const unsigned char *p = data + offsets[f];
+	float step[4] = { header.position_step, header.position_step, header.velocity_step, header.velocity_step };
+	int n, c, i;
+
+	get(p, &fh, 1);
+	n = (int)fh.num_balls;
+
+	current.prev_x.swap(current.x);
+	current.prev_y.swap(current.y);
+	current.step = fh.step;
+	current.dt = header.fixed_dt;
+	current.time = fh.step * (double)header.fixed_dt;
+	current.area = get_area();
+
+	current.walls.resize(fh.num_walls);
+	for (i = 0; i<(int)fh.num_walls; i++)
+	{
+		WallRecord r;
+		get(p, &r, 1);
+		current.walls[i] = make_wall(r);
+	}
+
+	current.x.resize(n);
+	current.y.resize(n);
+	current.vx.resize(n);
+	current.vy.resize(n);
+	float *dst[4] = { n ? &current.x[0] : 0, n ? &current.y[0] : 0, n ? &current.vx[0] : 0, n ? &current.vy[0] : 0 };
+
+	if (fh.type == DELTA_FRAME)
+	{
+		uint32_t num_escapes;
+
+		differences.resize(4 * n);
+		get(p, n ? &differences[0] : (int16_t *)0, 4 * n);
+		for (i = 0; i<4 * n; i++)
+		{
+			if (differences[i] != DELTA_ESCAPE) quantized[i] += differences[i];
+		}
+
+		get(p, &num_escapes, 1);
+		for (i = 0; i<(int)num_escapes; i++)
+		{
+			DeltaEscape e;
+			get(p, &e, 1);
+			quantized[e.slot] = e.value;
+		}
+
+		for (c = 0; c<4; c++)
+		{
+			for (i = 0; i<n; i++)
+				dst[c][i] = quantized[c*n + i] * step[c];
+		}
+	}
+	else
+	{
+		current.radius.resize(n);
+		current.density.resize(n);
+		current.color.resize(n);
+		quantized.resize(4 * n);
+
+		for (c = 0; c<4; c++)
+		{
+			get(p, dst[c], n);
+			for (i = 0; i<n; i++)
+				quantized[c*n + i] = (int32_t)lrintf(dst[c][i] / step[c]);
+		}
+		get(p, n ? &current.radius[0] : (float *)0, n);
+		get(p, n ? &current.density[0] : (float *)0, n);
+		get(p, n ? &current.color[0] : (sf::Color *)0, n);
+	}
+
+	if (current.prev_x.size() != current.x.size())
+	{
+		current.prev_x = current.x;
+		current.prev_y = current.y;
+	}
+	current_index = f;
+}
+
+//returns the step frame f was recorded at
+long long Player::get_step(int f) const
+{
+	ReplayFrameHeader fh;
+
+	memcpy(&fh, data + offsets[f], sizeof(fh));
+	return fh.step;
+}
+
+//returns the last frame recorded at or before step s (the first frame if there is none), like seek().
+//steps only grow through the file, so the frame is found by binary search over the index
+const ReplayFrame &Player::seek_step(long long s)
+{
+	int lo = 0;
+	int hi = (int)offsets.size() - 1;
+
+	if (offsets.empty()) return current;
+	while (lo<hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (get_step(mid) <= s) lo = mid;
+		else hi = mid - 1;
+	}
+	return seek(lo);
+}
+
+//returns frame f (clamped to the recorded range) with prev_x and prev_y from frame f - 1.
+//playing forward costs one frame; any other seek decodes at most KEY_FRAME_INTERVAL + 1 frames
+const ReplayFrame &Player::seek(int f)
+{
+	int k;
+
+	if (offsets.empty()) return current;
+	if (f<0) f = 0;
+	if (f >= (int)offsets.size()) f = (int)offsets.size() - 1;
+	if (f == current_index) return current;
+
+	if (f == current_index + 1)
+	{
+		decode(f);
+		return current;
+	}
+
+	//start at the key frame at or before f - 1, so f - 1 is decoded on the way
+	k = f>0 ? f - 1 : 0;
+	while (k>0 && get_frame_type(k) != KEY_FRAME)
+		k--;
+
+	decode(k);
+	current.prev_x = current.x;
+	current.prev_y = current.y;
+	while (current_index<f)
+		decode(current_index + 1);
+
+	return current;
+}
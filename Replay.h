@@ -0,0 +1,195 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "World.h"
+#include "Snapshot.h"
+#include "WallRecord.h"
+
+const uint32_t REPLAY_VERSION = 2;
+const uint32_t REPLAY_DELTA = 1;                    //flag: frames between key frames hold quantized differences
+const int KEY_FRAME_INTERVAL = 32;                  //a delta replay stores a whole frame at least this often
+const float REPLAY_POSITION_STEP = 1.0f / 64;       //quantization of positions in delta frames, in pixels
+const float REPLAY_VELOCITY_STEP = 1.0f / 16;       //quantization of velocities in delta frames, in pixels per second
+const int16_t DELTA_ESCAPE = -32768;                //difference that is replaced by a DeltaEscape
+const int MAX_PENDING_FRAMES = 8;                   //frames the recorder queues before it drops new ones
+
+enum ReplayFrameType { KEY_FRAME, DELTA_FRAME };
+
+//replay file layout, all little-endian:
+//  ReplayHeader
+//  every frame: ReplayFrameHeader, num_walls WallRecords, then the balls -
+//    key frame:   x, y, vx, vy, radius and density arrays of floats, then the colors as r, g, b, a bytes
+//    delta frame: x, y, vx, vy arrays of 16 bit differences from the previous frame, in quantization
+//                 steps, then a 32 bit count of DeltaEscapes for the values whose difference does not fit
+//                 (their difference is stored as DELTA_ESCAPE); radii, densities and colors are those
+//                 of the previous frame
+//  index: the 64 bit file offset of every frame
+//  ReplayFooter
+//a replay without REPLAY_DELTA has key frames only and is lossless. a file that was never closed
+//has no index or footer; its frames are still found by walking the size fields
+struct ReplayHeader
+{
+	char magic[8];                  //"BALLRPL"
+	uint32_t version;
+	uint32_t flags;
+	float fixed_dt;
+	float area[4];                  //left, top, width, height
+	float position_step;
+	float velocity_step;
+	uint32_t key_interval;
+};
+
+struct ReplayFrameHeader
+{
+	uint32_t size;                  //of the whole frame, this header included
+	uint32_t type;                  //ReplayFrameType
+	int64_t step;
+	uint32_t num_balls;
+	uint32_t num_walls;
+};
+
+struct DeltaEscape
+{
+	uint32_t slot;                  //c*num_balls + i for component c (x, y, vx, vy) of ball i
+	int32_t value;                  //in quantization steps
+};
+
+struct ReplayFooter
+{
+	uint64_t index_offset;
+	uint64_t num_frames;
+	char magic[8];                  //"BALLIDX"
+};
+
+//one recorded step: everything a Snapshot holds, plus what is needed to restart the simulation from it
+struct ReplayFrame : public Snapshot
+{
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<float> density;
+};
+
+void take_replay_frame(const World &world, ReplayFrame &f);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//streams frames of a world to a replay file. record() only copies the world into a queued frame;
+//encoding and writing happen on a background thread, so the caller never waits for the disk.
+//if the writer falls MAX_PENDING_FRAMES behind, new frames are dropped and counted instead, unless the
+//recorder is blocking: then record() waits for a frame to be written, so no step is lost. offline
+//drivers that record every step for debugging should block; interactive ones should not
+class Recorder
+{
+private:
+	FILE *file;
+	ReplayHeader header;
+	std::vector<uint64_t> offsets;      //of every frame written
+	uint64_t file_pos;
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable wake;       //a frame was queued, or the recorder is closing
+	std::condition_variable written;    //a frame buffer went back to spare
+	std::vector<std::unique_ptr<ReplayFrame> > frames;     //every frame buffer ever allocated
+	std::deque<ReplayFrame *> pending;
+	std::vector<ReplayFrame *> spare;
+	bool stopping;
+	bool blocking;                      //see set_blocking
+	long long recorded;
+	long long dropped;
+
+	//encoder state, only touched by the writer thread
+	std::vector<int32_t> quantized;     //x, y, vx, vy of the last frame, in quantization steps
+	std::vector<int32_t> next_quantized;
+	std::vector<int16_t> differences;
+	std::vector<DeltaEscape> escapes;
+	int since_key;
+	std::vector<char> buffer;
+
+	void work();
+	void write_frame(const ReplayFrame &f);
+
+	Recorder(const Recorder &);
+	Recorder &operator=(const Recorder &);
+
+public:
+	//Constructors
+	Recorder();
+	~Recorder();
+
+	//Getters
+	bool is_open() const                        { return file != 0; }
+	long long get_num_recorded() const          { return recorded; }
+	long long get_num_dropped() const           { return dropped; }
+	bool is_blocking() const                    { return blocking; }
+
+	//Setters
+	void set_blocking(bool b)                   { blocking = b; }
+
+	//Other functions
+	bool open(const char *path, const World &world, uint32_t flags);
+	void record(const World &world);
+	void close();
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//plays back a replay file through a read-only memory mapping. the index table makes seeking O(1):
+//a key frame is decoded directly, a delta frame from the key frame before it (at most
+//KEY_FRAME_INTERVAL frames back), and playing forward decodes one frame per step.
+//seek() also fills prev_x and prev_y with the frame before, so the result can be drawn
+//interpolated with BatchRenderer like a live Snapshot. frames are numbered in the order they were
+//written; a recorder that dropped frames leaves gaps in their steps, so seek_step() finds a frame by
+//the step it was recorded at
+class Player
+{
+private:
+	const unsigned char *data;
+	size_t size;
+#ifdef _WIN32
+	void *file;                     //HANDLEs, kept as void * so windows.h stays out of this header
+	void *mapping;
+#else
+	int fd;
+#endif
+
+	ReplayHeader header;
+	std::vector<uint64_t> offsets;
+	ReplayFrame current;
+	int current_index;              //frame held in current, -1 if none
+	std::vector<int32_t> quantized;
+	std::vector<int16_t> differences;
+
+	bool map(const char *path);
+	bool read_index();
+	uint32_t get_frame_type(int f) const;
+	void decode(int f);
+
+	Player(const Player &);
+	Player &operator=(const Player &);
+
+public:
+	//Constructors
+	Player();
+	~Player();
+
+	//Getters
+	bool is_open() const                        { return data != 0; }
+	int get_num_frames() const                  { return (int)offsets.size(); }
+	uint32_t get_flags() const                  { return header.flags; }
+	float get_fixed_dt() const                  { return header.fixed_dt; }
+	sf::FloatRect get_area() const;
+	long long get_step(int f) const;
+
+	//Other functions
+	bool open(const char *path);
+	void close();
+	const ReplayFrame &seek(int f);
+	const ReplayFrame &seek_step(long long s);
+};
@@ -0,0 +1,459 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Scene.h"
+#include "WallRecord.h"
+
+const char SCENE_MAGIC[8] = "BALLSCN";
+const size_t SCENE_READ_WORDS = 16384;      //first buffer load_scene reads into, in 4 byte words; doubled as the file needs
+const char *MATERIAL_NAMES[5] = { "wood", "stone", "iron", "gold", "def" };
+
+//returns a random float in [lo, hi), using rand()
+float random_float(float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() / (RAND_MAX + 1.0f));
+}
+
+//replaces the world with n random balls and m random walls covering about DENSITY of the arena
+void make_random_scene(World &world, int n, int m)
+{
+	make_random_scene(world, n, m, DENSITY);
+}
+
+//replaces the world with n balls of random size, material and velocity and m random walls.
+//the square arena is sized so balls cover about the given fraction of its area.
+//results depend on the rand() seed
+void make_random_scene(World &world, int n, int m, float density)
+{
+	const Material mats[5] = { WOOD, STONE, IRON, GOLD, DEF };
+	int i;
+
+	if (density <= 0) density = DENSITY;
+
+	float side = sqrt(n * PI * rDefault * rDefault / density);
+	if (side<4 * rDefault) side = 4 * rDefault;
+
+	world.clear();
+	world.set_area(sf::FloatRect(0, 0, side, side));
+	world.get_balls().reserve(n);
+
+	for (i = 0; i<n; i++)
+	{
+		sf::Vector2f pos(random_float(rDefault, side - rDefault), random_float(rDefault, side - rDefault));
+		world.add_ball(Ball(pos, random_float(0, 300), random_float(0, 360), random_float(rDefault / 2, rDefault), mats[i % 5]));
+	}
+
+	for (i = 0; i<m; i++)
+	{
+		sf::Vector2f p1(random_float(0, side), random_float(0, side));
+		sf::Vector2f p2 = p1 + sf::Vector2f(random_float(-100, 100), random_float(-100, 100));
+		world.add_wall(Wall(p1, p2));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//random sequence of the scene generators (xorshift32), independent of rand()
+float scene_random(uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216);
+}
+
+//weighted choice of materials for generated balls
+struct MaterialMix
+{
+	Material mats[5];
+	float weight[5];                //cumulative, the last one is the total
+	int n;
+};
+
+Material pick_material(const MaterialMix &mix, uint32_t &state)
+{
+	float w = scene_random(state) * mix.weight[mix.n - 1];
+	int k;
+
+	for (k = 0; k<mix.n - 1 && w >= mix.weight[k]; k++);
+	return mix.mats[k];
+}
+
+void skip_blanks(const char *&p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r')
+		p++;
+}
+
+//reads the next number on the line. returns false if there is none
+bool read_float(const char *&p, float &f)
+{
+	char *end;
+
+	skip_blanks(p);
+	f = strtof(p, &end);
+	if (end == p) return false;
+
+	p = end;
+	return true;
+}
+
+bool read_int(const char *&p, int &n)
+{
+	float f;
+
+	if (!read_float(p, f)) return false;
+	n = (int)f;
+	return true;
+}
+
+//reads the next word (everything up to a blank or the line end) into w, truncated to size - 1 characters
+bool read_word(const char *&p, char *w, int size)
+{
+	int len = 0;
+
+	skip_blanks(p);
+	while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+	{
+		if (len<size - 1) w[len++] = *p;
+		p++;
+	}
+	w[len] = 0;
+	return len>0;
+}
+
+//true if only blanks are left on the line
+bool at_line_end(const char *&p)
+{
+	skip_blanks(p);
+	return *p == 0 || *p == '\n';
+}
+
+bool parse_material(const char *w, int len, Material &mat)
+{
+	int k;
+
+	for (k = 0; k<5; k++)
+	{
+		if ((int)strlen(MATERIAL_NAMES[k]) == len && strncmp(w, MATERIAL_NAMES[k], len) == 0)
+		{
+			mat = (Material)k;
+			return true;
+		}
+	}
+	return false;
+}
+
+//parses "#rrggbb"
+bool parse_color(const char *w, sf::Color &c)
+{
+	char *end;
+
+	if (w[0] != '#' || strlen(w) != 7) return false;
+
+	unsigned long v = strtoul(w + 1, &end, 16);
+	if (*end) return false;
+
+	c = sf::Color((sf::Uint8)(v >> 16), (sf::Uint8)(v >> 8), (sf::Uint8)v);
+	return true;
+}
+
+//parses "wood" or "wood:3,iron:1"
+bool parse_mix(const char *w, MaterialMix &mix)
+{
+	float total = 0;
+
+	mix.n = 0;
+	while (*w && mix.n<5)
+	{
+		const char *name = w;
+		float weight = 1;
+
+		while (*w && *w != ':' && *w != ',')
+			w++;
+		if (!parse_material(name, (int)(w - name), mix.mats[mix.n])) return false;
+
+		if (*w == ':')
+		{
+			char *end;
+			weight = strtof(w + 1, &end);
+			if (end == w + 1 || weight<0) return false;
+			w = end;
+		}
+		if (*w == ',') w++;
+
+		total += weight;
+		mix.weight[mix.n++] = total;
+	}
+	return mix.n>0 && total>0 && *w == 0;
+}
+
+//adds cols*rows balls on a lattice, see load_scene
+void make_grid(World &world, float x, float y, int cols, int rows, float spacing, float r, float speed,
+	const MaterialMix &mix, uint32_t &state)
+{
+	BallSystem &balls = world.get_balls();
+	int i, j;
+
+	balls.reserve(balls.size() + cols * rows);
+	for (j = 0; j<rows; j++)
+	{
+		for (i = 0; i<cols; i++)
+		{
+			Material mat = pick_material(mix, state);
+			float ang = scene_random(state) * 2 * PI;
+
+			balls.add(sf::Vector2f(x + i * spacing, y + j * spacing), sf::Vector2f(speed * cos(ang), speed * sin(ang)),
+				r, get_material_color(mat), get_material_density(mat));
+		}
+	}
+}
+
+//adds count balls at random positions inside the world's area, see load_scene
+void make_random_fill(World &world, int count, float rmin, float rmax, float speed, const MaterialMix &mix, uint32_t &state)
+{
+	BallSystem &balls = world.get_balls();
+	sf::FloatRect a = world.get_area();
+	int i;
+
+	balls.reserve(balls.size() + count);
+	for (i = 0; i<count; i++)
+	{
+		Material mat = pick_material(mix, state);
+		float r = rmin + (rmax - rmin) * scene_random(state);
+		float x = a.left + r + (a.width - 2 * r) * scene_random(state);
+		float y = a.top + r + (a.height - 2 * r) * scene_random(state);
+		float spd = speed * scene_random(state);
+		float ang = scene_random(state) * 2 * PI;
+
+		balls.add(sf::Vector2f(x, y), sf::Vector2f(spd * cos(ang), spd * sin(ang)), r, get_material_color(mat), get_material_density(mat));
+	}
+}
+
+//replaces the world with the scene described by the argument text (see Scene.h).
+//returns 0 on success, or the number of the first line that cannot be parsed
+int load_scene_text(World &world, const char *text)
+{
+	const char *p = text;
+	uint32_t state = 1;
+	int line;
+	char cmd[16], w[64];
+
+	world.clear();
+
+	for (line = 1; *p; line++)
+	{
+		if (!at_line_end(p) && *p != '#')
+		{
+			if (!read_word(p, cmd, sizeof(cmd))) return line;
+
+			if (strcmp(cmd, "ball") == 0)
+			{
+				float x, y, u, v, r, dens;
+				Material mat;
+				sf::Color c;
+
+				if (!read_float(p, x) || !read_float(p, y) || !read_float(p, u) || !read_float(p, v) || !read_float(p, r) ||
+					!read_word(p, w, sizeof(w))) return line;
+
+				if (parse_material(w, (int)strlen(w), mat))
+				{
+					c = get_material_color(mat);
+					dens = get_material_density(mat);
+				}
+				else if (!parse_color(w, c) || !read_float(p, dens)) return line;
+
+				world.get_balls().add(sf::Vector2f(x, y), sf::Vector2f(u, v), r, c, dens);
+			}
+			else if (strcmp(cmd, "wall") == 0)
+			{
+				float x1, y1, x2, y2, th = thDefault;
+				sf::Color c = wcDefault;
+
+				if (!read_float(p, x1) || !read_float(p, y1) || !read_float(p, x2) || !read_float(p, y2)) return line;
+				if (!at_line_end(p) && !read_float(p, th)) return line;
+				if (!at_line_end(p) && (!read_word(p, w, sizeof(w)) || !parse_color(w, c))) return line;
+
+				world.add_wall(Wall(sf::Vector2f(x1, y1), sf::Vector2f(x2, y2), th, c));
+			}
+			else if (strcmp(cmd, "grid") == 0)
+			{
+				float x, y, spacing, r, speed;
+				int cols, rows;
+				MaterialMix mix;
+
+				if (!read_float(p, x) || !read_float(p, y) || !read_int(p, cols) || !read_int(p, rows) || !read_float(p, spacing) ||
+					!read_float(p, r) || !read_float(p, speed) || !read_word(p, w, sizeof(w)) || !parse_mix(w, mix)) return line;
+				if (cols<0 || rows<0) return line;
+
+				make_grid(world, x, y, cols, rows, spacing, r, speed, mix, state);
+			}
+			else if (strcmp(cmd, "random") == 0)
+			{
+				float rmin, rmax, speed;
+				int count;
+				MaterialMix mix;
+
+				if (!read_int(p, count) || !read_float(p, rmin) || !read_float(p, rmax) || !read_float(p, speed) ||
+					!read_word(p, w, sizeof(w)) || !parse_mix(w, mix)) return line;
+				if (count<0) return line;
+
+				make_random_fill(world, count, rmin, rmax, speed, mix, state);
+			}
+			else if (strcmp(cmd, "area") == 0)
+			{
+				float l, t, wd, h;
+
+				if (!read_float(p, l) || !read_float(p, t) || !read_float(p, wd) || !read_float(p, h)) return line;
+				world.set_area(sf::FloatRect(l, t, wd, h));
+			}
+			else if (strcmp(cmd, "dt") == 0)
+			{
+				float dt;
+
+				if (!read_float(p, dt)) return line;
+				world.set_fixed_dt(dt);
+			}
+			else if (strcmp(cmd, "seed") == 0)
+			{
+				int seed;
+
+				if (!read_int(p, seed)) return line;
+				state = seed ? (uint32_t)seed : 1;
+			}
+			else if (strcmp(cmd, "reserve") == 0)
+			{
+				int nb, nw;
+
+				if (!read_int(p, nb) || !read_int(p, nw)) return line;
+				world.reserve(nb, nw);
+			}
+			else return line;
+
+			if (!at_line_end(p)) return line;
+		}
+
+		//skip the rest of the line (all of it, for a comment)
+		while (*p && *p != '\n')
+			p++;
+		if (*p) p++;
+	}
+
+	return 0;
+}
+
+//replaces the world with the scene stored in a binary scene file's contents.
+//returns false, leaving the world untouched, if the data is not a complete scene of this version
+bool load_scene_binary(World &world, const unsigned char *data, size_t size)
+{
+	SceneHeader h;
+	int i;
+
+	if (size<sizeof(h)) return false;
+	memcpy(&h, data, sizeof(h));
+	if (memcmp(h.magic, SCENE_MAGIC, 8) != 0 || h.version != SCENE_VERSION) return false;
+
+	size_t n = h.num_balls;
+	if (size != sizeof(h) + n * (6 * sizeof(float) + sizeof(sf::Color)) + h.num_walls * sizeof(WallRecord)) return false;
+
+	world.clear();
+	world.set_area(sf::FloatRect(h.area[0], h.area[1], h.area[2], h.area[3]));
+	world.set_fixed_dt(h.fixed_dt);
+	world.reserve((int)n, (int)h.num_walls);
+
+	//every section is a multiple of 4 bytes long, so the float arrays stay aligned
+	const float *f = (const float *)(data + sizeof(h));
+	const sf::Color *c = (const sf::Color *)(f + 6 * n);
+	world.get_balls().add(f, f + n, f + 2 * n, f + 3 * n, f + 4 * n, f + 5 * n, c, (int)n);
+
+	const unsigned char *p = (const unsigned char *)(c + n);
+	for (i = 0; i<(int)h.num_walls; i++)
+	{
+		WallRecord r;
+		memcpy(&r, p + i * sizeof(r), sizeof(r));
+		world.add_wall(make_wall(r));
+	}
+	return true;
+}
+
+//replaces the world with the scene in the file at the argument path, binary or text.
+//returns 0 on success, -1 if the file cannot be read or is not a valid binary scene,
+//or the number of the first line of a text scene that cannot be parsed.
+//the file is read to its end in pieces, so it may be a pipe whose size is not known in advance
+int load_scene(World &world, const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file) return -1;
+
+	//one extra word, so text is terminated and binary data stays aligned
+	std::vector<uint32_t> buf(SCENE_READ_WORDS + 1, 0);
+	size_t size = 0;
+	size_t got;
+
+	while ((got = fread((char *)&buf[0] + size, 1, (buf.size() - 1) * 4 - size, file))>0)
+	{
+		size += got;
+		if (size == (buf.size() - 1) * 4) buf.resize(2 * buf.size() - 1, 0);
+	}
+	bool failed = ferror(file) != 0;
+	fclose(file);
+	if (failed) return -1;
+
+	const unsigned char *data = (const unsigned char *)&buf[0];
+	if (size >= 8 && memcmp(data, SCENE_MAGIC, 8) == 0)
+		return load_scene_binary(world, data, size) ? 0 : -1;
+	return load_scene_text(world, (const char *)data);
+}
+
+//writes the balls and walls of the world to a binary scene file. returns false if it cannot be written
+bool save_scene(const World &world, const char *path)
+{
+	const BallSystem &balls = world.get_balls();
+	int n = balls.size();
+	int i;
+
+	FILE *file = fopen(path, "wb");
+	if (!file) return false;
+
+	SceneHeader h;
+	memcpy(h.magic, SCENE_MAGIC, 8);
+	h.version = SCENE_VERSION;
+	h.num_balls = n;
+	h.num_walls = world.get_num_walls();
+	h.area[0] = world.get_area().left;
+	h.area[1] = world.get_area().top;
+	h.area[2] = world.get_area().width;
+	h.area[3] = world.get_area().height;
+	h.fixed_dt = world.get_fixed_dt();
+
+	std::vector<float> dens(n);
+	std::vector<sf::Color> colors(n);
+	for (i = 0; i<n; i++)
+	{
+		dens[i] = balls.get_density(i);
+		colors[i] = balls.get_color(i);
+	}
+
+	fwrite(&h, sizeof(h), 1, file);
+	fwrite(balls.get_x(), sizeof(float), n, file);
+	fwrite(balls.get_y(), sizeof(float), n, file);
+	fwrite(balls.get_vx(), sizeof(float), n, file);
+	fwrite(balls.get_vy(), sizeof(float), n, file);
+	fwrite(balls.get_radii(), sizeof(float), n, file);
+	if (n>0)
+	{
+		fwrite(&dens[0], sizeof(float), n, file);
+		fwrite(&colors[0], sizeof(sf::Color), n, file);
+	}
+
+	for (i = 0; i<world.get_num_walls(); i++)
+	{
+		WallRecord r = make_wall_record(world.get_wall(i));
+		fwrite(&r, sizeof(r), 1, file);
+	}
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
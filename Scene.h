@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "ball.h"
+#include "World.h"
+
+const float DENSITY = 0.25f;            //default fraction of the arena area covered by balls
+const uint32_t SCENE_VERSION = 2;
+
+float random_float(float lo, float hi);
+void make_random_scene(World &world, int n, int m);
+void make_random_scene(World &world, int n, int m, float density);
+
+//scene text format: one command per line; lines starting with '#' are comments.
+//  area <left> <top> <width> <height>              arena; defaults to the world's current one
+//  dt <seconds>                                    fixed timestep
+//  seed <n>                                        seeds the generators below (default 1)
+//  reserve <balls> <walls>                         optional capacity hint for large explicit lists
+//  ball <x> <y> <vx> <vy> <r> <material>           material is wood, stone, iron, gold or def
+//  ball <x> <y> <vx> <vy> <r> #rrggbb <density>
+//  wall <x1> <y1> <x2> <y2> [<thickness> [#rrggbb]]
+//  grid <x> <y> <cols> <rows> <spacing> <r> <speed> <mix>
+//      cols*rows balls on a square lattice starting at (x, y), moving at speed in random directions
+//  random <count> <rmin> <rmax> <speed> <mix>
+//      balls at random positions inside the area, with radii in [rmin, rmax) and speeds in [0, speed)
+//a mix is a material or a comma separated list of material:weight pairs, e.g. wood:3,iron:1.
+//generators use their own random sequence, so a scene file always produces the same scene
+int load_scene(World &world, const char *path);
+int load_scene_text(World &world, const char *text);
+
+//scene binary format, little-endian: SceneHeader, then x, y, vx, vy, radius and density arrays of
+//floats, the colors as r, g, b, a bytes and num_walls WallRecords (see WallRecord.h).
+//it holds explicit lists only; save_scene writes the state of a world, generated or not
+struct SceneHeader
+{
+	char magic[8];                  //"BALLSCN"
+	uint32_t version;
+	uint32_t num_balls;
+	uint32_t num_walls;
+	float area[4];                  //left, top, width, height
+	float fixed_dt;
+};
+
+bool load_scene_binary(World &world, const unsigned char *data, size_t size);
+bool save_scene(const World &world, const char *path);
@@ -0,0 +1,63 @@
+#include "Snapshot.h"
+
+const int FRESH_SNAPSHOT = 4;       //flag on SnapshotBuffer::middle, above the slot index
+
+//copies the argument world into s. prev_x and prev_y hold the ball positions one step earlier.
+//the vectors in s are reused, so taking a snapshot does not allocate once they have grown
+void take_snapshot(const World &world, const float *prev_x, const float *prev_y, double time, Snapshot &s)
+{
+	const BallSystem &balls = world.get_balls();
+	int n = balls.size();
+	int i;
+
+	s.step = world.get_step_count();
+	s.time = time;
+	s.dt = world.get_fixed_dt();
+	s.area = world.get_area();
+
+	s.x.assign(balls.get_x(), balls.get_x() + n);
+	s.y.assign(balls.get_y(), balls.get_y() + n);
+	s.prev_x.assign(prev_x, prev_x + n);
+	s.prev_y.assign(prev_y, prev_y + n);
+	s.radius.assign(balls.get_radii(), balls.get_radii() + n);
+
+	s.color.resize(n);
+	for (i = 0; i<n; i++)
+		s.color[i] = balls.get_color(i);
+
+	s.walls.assign(world.get_walls(), world.get_walls() + world.get_num_walls());
+}
+
+//Default SnapshotBuffer constructor
+//slot 0 is the writer's, 1 the reader's and 2 the (empty, not fresh) published one
+SnapshotBuffer::SnapshotBuffer()
+{
+	int i;
+
+	back = 0;
+	front = 1;
+	middle = 2;
+
+	for (i = 0; i<3; i++)
+	{
+		slots[i].step = -1;
+		slots[i].time = 0;
+		slots[i].dt = 0;
+	}
+}
+
+//makes the back slot the latest snapshot and gives the writer the previous one to fill
+void SnapshotBuffer::publish()
+{
+	back = middle.exchange(back | FRESH_SNAPSHOT, std::memory_order_acq_rel) & 3;
+}
+
+//moves the latest published snapshot to the front, if there is one the reader has not seen.
+//returns whether the front slot changed
+bool SnapshotBuffer::acquire()
+{
+	if (!(middle.load(std::memory_order_relaxed) & FRESH_SNAPSHOT)) return false;
+
+	front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+	return true;
+}
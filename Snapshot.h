@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "ball.h"
+#include "World.h"
+
+//what the renderer needs of a world at one physics step.
+//balls are stored at the end of the step and at the end of the step before it,
+//so a snapshot can be drawn at any moment in between on its own
+struct Snapshot
+{
+	long long step;                 //World::get_step_count() when taken
+	double time;                    //simulated seconds at the end of the step
+	float dt;                       //length of the step
+	sf::FloatRect area;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> prev_x;      //positions one step earlier
+	std::vector<float> prev_y;
+	std::vector<float> radius;
+	std::vector<sf::Color> color;
+	std::vector<Wall> walls;
+};
+
+void take_snapshot(const World &world, const float *prev_x, const float *prev_y, double time, Snapshot &s);
+
+//hands snapshots from one writer thread to one reader thread without locking or copying.
+//the writer fills the back slot and publishes it; the reader takes the most recently
+//published slot. neither side ever waits, and the reader skips snapshots it was too slow for
+class SnapshotBuffer
+{
+private:
+	Snapshot slots[3];
+	int back;                       //owned by the writer
+	int front;                      //owned by the reader
+	std::atomic<int> middle;        //last published slot, with FRESH_SNAPSHOT set until the reader takes it
+
+	SnapshotBuffer(const SnapshotBuffer &);
+	SnapshotBuffer &operator=(const SnapshotBuffer &);
+
+public:
+	//Constructors
+	SnapshotBuffer();
+
+	//Getters
+	Snapshot &get_back()                        { return slots[back]; }
+	const Snapshot &get_front() const           { return slots[front]; }
+
+	//Other functions
+	void publish();
+	bool acquire();
+};
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include "SpatialIndex.h"
+
+//Default SpatialIndex constructor - an empty index
+SpatialIndex::SpatialIndex()
+{
+	step = -1;
+	bounds[0] = bounds[1] = 0;
+	bounds[2] = bounds[3] = 0;
+	wall_set = std::make_shared<IndexWalls>();
+}
+
+//copies the m walls of ws. bvh, if not null, must be a BVH over exactly those walls, such as a world's
+//own one kept up to date by refits; it is copied instead of building a new one
+void SpatialIndex::set_walls(const Wall *ws, int m, const WallBVH *bvh)
+{
+	std::shared_ptr<IndexWalls> set = std::make_shared<IndexWalls>();
+
+	set->walls.assign(ws, ws + m);
+	if (bvh) set->bvh = *bvh;
+	else set->bvh.build(set->walls.empty() ? 0 : &set->walls[0], m);
+	wall_set = set;
+}
+
+//copies the balls, in id order, and builds the grid over them. the copy is split into blocks over the
+//pool, which may be null. the grid covers area with cells of the argument size, like the world's own.
+//s is the step count. the walls are set separately
+void SpatialIndex::build(const BallSystem &balls, sf::FloatRect area, float cell, long long s, ThreadPool *pool)
+{
+	int n = balls.size();
+	const int *index = balls.get_indices();
+	const float *bx = balls.get_x();
+	const float *by = balls.get_y();
+	const float *br = balls.get_radii();
+	int blocks = pool ? pool->get_num_threads() : 1;
+	int b;
+
+	if (blocks>n / MIN_INDEX_BLOCK) blocks = n / MIN_INDEX_BLOCK;
+	if (blocks<1) blocks = 1;
+
+	std::vector<float> block_bounds(4 * blocks);
+
+	step = s;
+	x.resize(n);
+	y.resize(n);
+	r.resize(n);
+
+	auto copy_blocks = [&](int first, int last)
+	{
+		for (int k = first; k<last; k++)
+		{
+			float *bb = &block_bounds[4 * k];
+			int end = (int)((long long)n * (k + 1) / blocks);
+
+			bb[0] = bb[1] = 1e30f;
+			bb[2] = bb[3] = -1e30f;
+			for (int id = (int)((long long)n * k / blocks); id<end; id++)
+			{
+				int i = index[id];
+
+				x[id] = bx[i];
+				y[id] = by[i];
+				r[id] = br[i];
+				if (x[id] - r[id]<bb[0]) bb[0] = x[id] - r[id];
+				if (y[id] - r[id]<bb[1]) bb[1] = y[id] - r[id];
+				if (x[id] + r[id]>bb[2]) bb[2] = x[id] + r[id];
+				if (y[id] + r[id]>bb[3]) bb[3] = y[id] + r[id];
+			}
+		}
+	};
+
+	if (pool && blocks>1) pool->parallel_for(blocks, 1, copy_blocks);
+	else copy_blocks(0, blocks);
+
+	bounds[0] = bounds[1] = 1e30f;
+	bounds[2] = bounds[3] = -1e30f;
+	for (b = 0; b<blocks; b++)
+	{
+		if (block_bounds[4 * b]<bounds[0]) bounds[0] = block_bounds[4 * b];
+		if (block_bounds[4 * b + 1]<bounds[1]) bounds[1] = block_bounds[4 * b + 1];
+		if (block_bounds[4 * b + 2]>bounds[2]) bounds[2] = block_bounds[4 * b + 2];
+		if (block_bounds[4 * b + 3]>bounds[3]) bounds[3] = block_bounds[4 * b + 3];
+	}
+
+	if (grid.get_area() != area) grid.set_area(area);
+	grid.set_cell_size(cell);
+	if (n>0) grid.rebuild(&x[0], &y[0], &r[0], n);
+	else grid.rebuild(0, 0, 0, 0);
+}
+
+//appends the id of every ball containing the argument point
+void SpatialIndex::balls_at(sf::Vector2f pt, std::vector<int> &found) const
+{
+	size_t start = found.size();
+	size_t kept = start;
+	size_t k;
+
+	grid.query(pt.x, pt.y, pt.x, pt.y, found);
+	for (k = start; k<found.size(); k++)
+	{
+		int id = found[k];
+		float dx = pt.x - x[id];
+		float dy = pt.y - y[id];
+
+		if (dx*dx + dy*dy<r[id] * r[id]) found[kept++] = id;
+	}
+	found.resize(kept);
+}
+
+//appends the id of every ball overlapping the argument rectangle
+void SpatialIndex::balls_in_rect(sf::FloatRect rect, std::vector<int> &found) const
+{
+	float right = rect.left + rect.width;
+	float bottom = rect.top + rect.height;
+	size_t start = found.size();
+	size_t kept = start;
+	size_t k;
+
+	grid.query(rect.left, rect.top, right, bottom, found);
+	for (k = start; k<found.size(); k++)
+	{
+		int id = found[k];
+
+		//nearest point of the rectangle to the centre
+		float nx = x[id]<rect.left ? rect.left : x[id]>right ? right : x[id];
+		float ny = y[id]<rect.top ? rect.top : y[id]>bottom ? bottom : y[id];
+		float dx = nx - x[id];
+		float dy = ny - y[id];
+
+		if (dx*dx + dy*dy<r[id] * r[id]) found[kept++] = id;
+	}
+	found.resize(kept);
+}
+
+//appends the id of every ball overlapping the circle of the argument centre and radius
+void SpatialIndex::balls_in_circle(sf::Vector2f c, float radius, std::vector<int> &found) const
+{
+	size_t start = found.size();
+	size_t kept = start;
+	size_t k;
+
+	grid.query(c.x - radius, c.y - radius, c.x + radius, c.y + radius, found);
+	for (k = start; k<found.size(); k++)
+	{
+		int id = found[k];
+		float dx = c.x - x[id];
+		float dy = c.y - y[id];
+		float reach = radius + r[id];
+
+		if (dx*dx + dy*dy<reach*reach) found[kept++] = id;
+	}
+	found.resize(kept);
+}
+
+//appends the ids of the k balls whose surfaces are nearest the argument point, nearest first
+//(fewer if there are not k balls). a ball containing the point counts as nearer the deeper the point is.
+//searches a square around the point that doubles in size until it holds k balls nearer than its
+//half-width, since no ball outside the square can be nearer than that
+void SpatialIndex::nearest_balls(sf::Vector2f pt, int k, std::vector<int> &found) const
+{
+	std::vector<int> candidates;
+	std::vector<std::pair<float, int> > near;
+	float reach = grid.get_cell_size();
+	int j;
+
+	if (k <= 0 || x.empty()) return;
+
+	for (;;)
+	{
+		bool everything = pt.x - reach <= bounds[0] && pt.y - reach <= bounds[1] && pt.x + reach >= bounds[2] && pt.y + reach >= bounds[3];
+
+		candidates.clear();
+		near.clear();
+		grid.query(pt.x - reach, pt.y - reach, pt.x + reach, pt.y + reach, candidates);
+		for (j = 0; j<(int)candidates.size(); j++)
+		{
+			int id = candidates[j];
+			float d = distance(pt, sf::Vector2f(x[id], y[id])) - r[id];
+
+			if (d<reach || everything) near.push_back(std::make_pair(d, id));
+		}
+
+		if ((int)near.size() >= k || everything) break;
+		reach *= 2;
+	}
+
+	if (k>(int)near.size()) k = (int)near.size();
+	std::partial_sort(near.begin(), near.begin() + k, near.end());
+	for (j = 0; j<k; j++)
+		found.push_back(near[j].second);
+}
+
+//appends the index of every wall containing the argument point
+void SpatialIndex::walls_at(sf::Vector2f pt, std::vector<int> &found) const
+{
+	size_t start = found.size();
+	size_t kept = start;
+	size_t k;
+
+	wall_set->bvh.query(pt.x, pt.y, pt.x, pt.y, found);
+	for (k = start; k<found.size(); k++)
+	{
+		if (wall_set->walls[found[k]].contains(pt)) found[kept++] = found[k];
+	}
+	found.resize(kept);
+}
+
+//returns whether the argument wall overlaps the argument rectangle, by separating axes:
+//the two of the rectangle and the two of the wall
+static bool wall_overlaps_rect(const Wall &w, const sf::FloatRect &rect)
+{
+	sf::Vector2f u = w.get_tangent();
+	sf::Vector2f v = w.get_normal();
+	float ux = u.x<0 ? -u.x : u.x, uy = u.y<0 ? -u.y : u.y;
+	float vx = v.x<0 ? -v.x : v.x, vy = v.y<0 ? -v.y : v.y;
+	float hl = w.get_length() / 2;
+	float th = w.get_thickness();
+	float hw = rect.width / 2;
+	float hh = rect.height / 2;
+
+	//from the centre of the wall to the centre of the rectangle
+	sf::Vector2f d = sf::Vector2f(rect.left + hw, rect.top + hh) - 0.5f * (w.get_pt1() + w.get_pt2());
+	float du = dot(d, u), dv = dot(d, v);
+
+	if ((d.x<0 ? -d.x : d.x)>hw + ux*hl + vx*th) return false;
+	if ((d.y<0 ? -d.y : d.y)>hh + uy*hl + vy*th) return false;
+	if ((du<0 ? -du : du)>hl + hw*ux + hh*uy) return false;
+	if ((dv<0 ? -dv : dv)>th + hw*vx + hh*vy) return false;
+	return true;
+}
+
+//appends the index of every wall overlapping the argument rectangle
+void SpatialIndex::walls_in_rect(sf::FloatRect rect, std::vector<int> &found) const
+{
+	size_t start = found.size();
+	size_t kept = start;
+	size_t k;
+
+	wall_set->bvh.query(rect.left, rect.top, rect.left + rect.width, rect.top + rect.height, found);
+	for (k = start; k<found.size(); k++)
+	{
+		if (wall_overlaps_rect(wall_set->walls[found[k]], rect)) found[kept++] = found[k];
+	}
+	found.resize(kept);
+}
+
+//appends the index of every wall overlapping the circle of the argument centre and radius
+void SpatialIndex::walls_in_circle(sf::Vector2f c, float radius, std::vector<int> &found) const
+{
+	size_t start = found.size();
+	size_t kept = start;
+	size_t k;
+
+	wall_set->bvh.query(c.x - radius, c.y - radius, c.x + radius, c.y + radius, found);
+	for (k = start; k<found.size(); k++)
+	{
+		const Wall &w = wall_set->walls[found[k]];
+		sf::Vector2f p = w.relative_coordinates(c);
+		float th = w.get_thickness();
+
+		//distance from c to the nearest point of the wall, along and across it
+		float dx = p.x<0 ? -p.x : p.x>w.get_length() ? p.x - w.get_length() : 0;
+		float dy = p.y<-th ? -th - p.y : p.y>th ? p.y - th : 0;
+
+		if (dx*dx + dy*dy<radius*radius) found[kept++] = found[k];
+	}
+	found.resize(kept);
+}
+
+//narrows [t0, t1] to the part of the ray origin + t * dir inside the argument box (left, top, right, bottom).
+//returns false if none of it is
+static bool clip_ray(const sf::Vector2f &origin, const sf::Vector2f &dir, const float *box, float &t0, float &t1)
+{
+	int a;
+
+	for (a = 0; a<2; a++)
+	{
+		float o = a == 0 ? origin.x : origin.y;
+		float d = a == 0 ? dir.x : dir.y;
+
+		if (d == 0)
+		{
+			if (o<box[a] || o>box[a + 2]) return false;
+			continue;
+		}
+
+		float ta = (box[a] - o) / d;
+		float tb = (box[a + 2] - o) / d;
+		if (ta>tb) std::swap(ta, tb);
+		if (ta>t0) t0 = ta;
+		if (tb<t1) t1 = tb;
+	}
+	return t0 <= t1;
+}
+
+//finds the first ball or wall the ray from origin along dir meets within max_dist and returns whether
+//there was one. a ray starting inside a ball or wall hits it at distance 0.
+//walls come from the BVH; balls from the grid, a few cells of the ray at a time, stopping at the
+//first piece of the ray beyond a hit already found
+bool SpatialIndex::raycast(sf::Vector2f origin, sf::Vector2f dir, float max_dist, RayHit &hit) const
+{
+	std::vector<int> candidates;
+	float len = magnitude(dir);
+	float best = -1;
+	float t0 = 0, t1 = max_dist;
+	float t, seg;
+	int k;
+
+	if (len == 0 || max_dist <= 0) return false;
+	dir /= len;
+
+	wall_set->bvh.query_ray(origin, dir, max_dist, candidates);
+	for (k = 0; k<(int)candidates.size(); k++)
+	{
+		const Wall &w = wall_set->walls[candidates[k]];
+		t = w.contains(origin) ? 0 : sweep_wall(w, origin, dir, 0, max_dist);
+
+		if (t >= 0 && (best<0 || t<best))
+		{
+			best = t;
+			hit.wall = true;
+			hit.index = candidates[k];
+		}
+	}
+
+	seg = RAY_SEGMENT_CELLS * grid.get_cell_size();
+	if (!x.empty() && clip_ray(origin, dir, bounds, t0, t1))
+	{
+		for (t = t0; t<t1 && (best<0 || t<best); t += seg)
+		{
+			float e = t + seg<t1 ? t + seg : t1;
+			sf::Vector2f a = origin + t * dir;
+			sf::Vector2f b = origin + e * dir;
+
+			candidates.clear();
+			grid.query(a.x<b.x ? a.x : b.x, a.y<b.y ? a.y : b.y, a.x>b.x ? a.x : b.x, a.y>b.y ? a.y : b.y, candidates);
+			for (k = 0; k<(int)candidates.size(); k++)
+			{
+				int id = candidates[k];
+				sf::Vector2f rel = origin - sf::Vector2f(x[id], y[id]);
+				float ti = dot(rel, rel)<r[id] * r[id] ? 0 : sweep_circle(rel, dir, r[id], max_dist);
+
+				if (ti >= 0 && (best<0 || ti<best))
+				{
+					best = ti;
+					hit.wall = false;
+					hit.index = id;
+				}
+			}
+		}
+	}
+
+	if (best<0) return false;
+	hit.t = best;
+	hit.point = origin + best * dir;
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "ball.h"
+#include "BallSystem.h"
+#include "Grid.h"
+#include "ThreadPool.h"
+#include "WallBVH.h"
+
+const float RAY_SEGMENT_CELLS = 4;          //a ray is walked through the ball grid this many cells at a time
+const int MIN_INDEX_BLOCK = 4096;           //fewest balls a thread copies into an index on its own
+
+//the first thing a ray hits
+struct RayHit
+{
+	float t;                //distance along the ray
+	sf::Vector2f point;
+	bool wall;              //a wall was hit rather than a ball
+	int index;              //ball id or wall index
+};
+
+//the walls of an index and the BVH over them, shared by consecutive indices while no wall changes
+struct IndexWalls
+{
+	std::vector<Wall> walls;
+	WallBVH bvh;
+};
+
+//copy of the balls and walls of a world at one step, with a grid over the balls and a BVH over the walls,
+//for answering "what is here" without scanning every ball. balls are reported by id, walls by index.
+//queries only read the index, so any number of threads can run them at once; World builds a
+//separate index after every step (see World::set_indexing) and never changes one it has published.
+//consecutive indices share their walls until a wall changes
+//results are appended to the argument vector, in no particular order unless stated
+class SpatialIndex
+{
+private:
+	long long step;                 //World::get_step_count() when built
+	std::vector<float> x;           //by ball id
+	std::vector<float> y;
+	std::vector<float> r;
+	float bounds[4];                //box around every ball: left, top, right, bottom
+	Grid grid;
+
+	std::shared_ptr<const IndexWalls> wall_set;     //never null
+
+public:
+	//Constructors
+	SpatialIndex();
+
+	//Getters
+	long long get_step() const                  { return step; }
+	int get_num_balls() const                   { return (int)x.size(); }
+	int get_num_walls() const                   { return (int)wall_set->walls.size(); }
+	sf::Vector2f get_position(int id) const     { return sf::Vector2f(x[id], y[id]); }
+	float get_radius(int id) const              { return r[id]; }
+	const Wall &get_wall(int i) const           { return wall_set->walls[i]; }
+
+	//Setters
+	void set_walls(const Wall *ws, int m, const WallBVH *bvh);
+	void share_walls(const SpatialIndex &other)     { wall_set = other.wall_set; }
+
+	//Other functions
+	void build(const BallSystem &balls, sf::FloatRect area, float cell, long long s, ThreadPool *pool);
+
+	void balls_at(sf::Vector2f pt, std::vector<int> &found) const;
+	void balls_in_rect(sf::FloatRect rect, std::vector<int> &found) const;
+	void balls_in_circle(sf::Vector2f c, float radius, std::vector<int> &found) const;
+	void nearest_balls(sf::Vector2f pt, int k, std::vector<int> &found) const;
+
+	void walls_at(sf::Vector2f pt, std::vector<int> &found) const;
+	void walls_in_rect(sf::FloatRect rect, std::vector<int> &found) const;
+	void walls_in_circle(sf::Vector2f c, float radius, std::vector<int> &found) const;
+
+	bool raycast(sf::Vector2f origin, sf::Vector2f dir, float max_dist, RayHit &hit) const;
+};
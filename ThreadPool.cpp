@@ -0,0 +1,315 @@
+#include "ThreadPool.h"
+
+//pool and queue of the thread running, so a thread of the pool pushes onto its own queue
+static thread_local const ThreadPool *current_pool = 0;
+static thread_local int current_queue = 0;
+
+//queues claimed by a thread outside the pools it uses, by pool serial
+static thread_local std::vector<std::pair<long long, int> > outside_queues;
+static std::atomic<long long> next_pool_serial(0);
+
+//Default ThreadPool constructor - one thread per hardware core
+ThreadPool::ThreadPool()
+{
+	int n = (int)std::thread::hardware_concurrency();
+
+	start(n>0 ? n : 1);
+}
+
+//Constructor
+ThreadPool::ThreadPool(int threads)
+{
+	start(threads);
+}
+
+//starts threads - 1 workers. the pool cannot be copied, so constructors share this instead of
+//assigning from a temporary; at least one thread (the caller) is always used
+void ThreadPool::start(int threads)
+{
+	int i;
+
+	queued = 0;
+	sleepers = 0;
+	stopping = false;
+	num_outside = 0;
+	serial = next_pool_serial++;
+
+	if (threads<1) threads = 1;
+	for (i = 0; i<threads - 1 + OUTSIDE_QUEUES; i++)
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+
+	for (i = 0; i<threads - 1; i++)
+		workers.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	int i;
+
+	stopping = true;
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+	}
+	wake.notify_all();
+
+	for (i = 0; i<(int)workers.size(); i++)
+		workers[i].join();
+}
+
+//index of the calling thread's queue. a thread outside the pool claims one the first time it asks
+int ThreadPool::get_queue()
+{
+	int k;
+
+	if (current_pool == this) return current_queue;
+
+	for (k = 0; k<(int)outside_queues.size(); k++)
+		if (outside_queues[k].first == serial) return outside_queues[k].second;
+
+	int q = num_outside++;
+	if (q >= OUTSIDE_QUEUES) q = OUTSIDE_QUEUES - 1;
+	q += (int)workers.size();
+	outside_queues.push_back(std::make_pair(serial, q));
+	return q;
+}
+
+//adds a task to the back of queue q and wakes a worker if any is asleep.
+//queued is raised before sleepers is read, and a worker raises sleepers before it reads queued,
+//so either the worker sees the task or this thread sees the worker and takes sleep_lock to wake it
+void ThreadPool::push(int q, const Task &t)
+{
+	{
+		std::lock_guard<std::mutex> guard(queues[q]->lock);
+		queues[q]->tasks.push_back(t);
+	}
+	queued++;
+
+	if (sleepers>0)
+	{
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock);
+		}
+		wake.notify_one();
+	}
+}
+
+//takes the newest task of queue q, which the owner most likely still has in cache
+bool ThreadPool::pop(int q, Task &t)
+{
+	std::lock_guard<std::mutex> guard(queues[q]->lock);
+
+	if (queues[q]->tasks.empty()) return false;
+	t = queues[q]->tasks.back();
+	queues[q]->tasks.pop_back();
+	queued--;
+	return true;
+}
+
+//takes the oldest task of some other queue, starting after q, and only of the loop counted by left
+//unless that is null. the oldest task holds the largest range
+bool ThreadPool::steal(int q, const std::atomic<int> *left, Task &t)
+{
+	int n = (int)queues.size();
+	int k;
+
+	for (k = 1; k<n; k++)
+	{
+		WorkQueue &victim = *queues[(q + k) % n];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		std::deque<Task>::iterator it;
+
+		for (it = victim.tasks.begin(); it != victim.tasks.end(); ++it)
+		{
+			if (left && it->left != left) continue;
+
+			t = *it;
+			victim.tasks.erase(it);
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+//runs one task from queue q, or stolen from another, and returns false if there was none
+bool ThreadPool::run_one(int q)
+{
+	Task t;
+
+	if (!pop(q, t) && !steal(q, 0, t)) return false;
+	run(q, t);
+	return true;
+}
+
+//halves the task until it has at most grain items, leaving the upper halves on queue q, then runs it
+void ThreadPool::run(int q, Task t)
+{
+	while (t.end - t.begin>t.grain)
+	{
+		Task upper = t;
+		upper.begin = t.begin + (t.end - t.begin) / 2;
+		push(q, upper);
+		t.end = upper.begin;
+	}
+
+	(*t.fn)(t.begin, t.end);
+	t.left->fetch_sub(t.end - t.begin, std::memory_order_acq_rel);
+}
+
+//worker thread: runs its own tasks and steals others, and sleeps once none have turned up for a while
+void ThreadPool::work(int q)
+{
+	int idle = 0;
+
+	current_pool = this;
+	current_queue = q;
+
+	while (!stopping)
+	{
+		if (run_one(q))
+		{
+			idle = 0;
+			continue;
+		}
+		if (++idle<IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		sleepers++;
+		while (!stopping && queued == 0)
+			wake.wait(guard);
+		sleepers--;
+		idle = 0;
+	}
+}
+
+//calls fn(begin, end) over consecutive subranges covering [0, n) and returns when all have finished.
+//subranges may run in any order and on any thread, so fn must not write anything another
+//subrange reads or writes
+void ThreadPool::parallel_for(int n, const std::function<void(int, int)> &fn)
+{
+	parallel_for(n, n / (SPLITS_PER_THREAD * get_num_threads()), fn);
+}
+
+//same as above, with subranges of at most grain items (at least 1)
+void ThreadPool::parallel_for(int n, int grain, const std::function<void(int, int)> &fn)
+{
+	if (n <= 0) return;
+	if (workers.empty() || n == 1)
+	{
+		fn(0, n);
+		return;
+	}
+
+	std::atomic<int> left(n);
+	Task t = { &fn, 0, n, grain>1 ? grain : 1, &left };
+
+	run(get_queue(), t);
+	wait(left);
+}
+
+//queues fn(begin, end), split down to grain items, and returns at once. left must include the
+//end - begin items and is lowered by them as they finish; fn and left must outlive the task
+void ThreadPool::submit(const std::function<void(int, int)> &fn, int begin, int end, int grain, std::atomic<int> &left)
+{
+	Task t = { &fn, begin, end, grain>1 ? grain : 1, &left };
+
+	if (end>begin) push(get_queue(), t);
+}
+
+//runs tasks until left reaches zero: any on the caller's own queue, which only holds pieces of loops
+//it started or joined, and those of this loop on other queues
+void ThreadPool::wait(const std::atomic<int> &left)
+{
+	int q = get_queue();
+	Task t;
+
+	while (left.load(std::memory_order_acquire)>0)
+	{
+		if (pop(q, t) || steal(q, &left, t)) run(q, t);
+		else std::this_thread::yield();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Default TaskGraph constructor
+TaskGraph::TaskGraph()
+{
+	left = 0;
+	running = 0;
+}
+
+//adds a stage and returns its index
+int TaskGraph::add(const std::function<void()> &fn)
+{
+	stages.push_back(fn);
+	successors.push_back(std::vector<int>());
+	num_prerequisites.push_back(0);
+	return (int)stages.size() - 1;
+}
+
+//makes stage after wait until stage before has finished. before must be added first
+void TaskGraph::depend(int before, int after)
+{
+	if (before<0 || after<0 || before >= after) return;
+
+	successors[before].push_back(after);
+	num_prerequisites[after]++;
+}
+
+//removes every stage, keeping the memory for the next frame
+void TaskGraph::clear()
+{
+	stages.clear();
+	successors.clear();
+	num_prerequisites.clear();
+}
+
+//runs every stage, in the order of the dependencies, and returns when all have finished.
+//without a pool the stages run one after another in the order they were added, which is always
+//a valid order since a stage can only depend on earlier ones
+void TaskGraph::run(ThreadPool *pool)
+{
+	int n = (int)stages.size();
+	int s;
+
+	if (!pool || pool->get_num_threads() == 1)
+	{
+		for (s = 0; s<n; s++)
+			stages[s]();
+		return;
+	}
+
+	waiting.reset(new std::atomic<int>[n]);
+	for (s = 0; s<n; s++)
+		waiting[s] = num_prerequisites[s];
+	left = n;
+	running = pool;
+
+	//a stage queues the successors it was the last prerequisite of before it counts itself as
+	//finished, so left cannot reach zero while any stage is still to be queued
+	runner = [this](int begin, int end)
+	{
+		for (int s = begin; s<end; s++)
+		{
+			stages[s]();
+			for (int k = 0; k<(int)successors[s].size(); k++)
+			{
+				int next = successors[s][k];
+				if (waiting[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+					running->submit(runner, next, next + 1, 1, left);
+			}
+		}
+	};
+
+	for (s = 0; s<n; s++)
+	{
+		if (num_prerequisites[s] == 0) pool->submit(runner, s, s + 1, 1, left);
+	}
+	pool->wait(left);
+	running = 0;
+}
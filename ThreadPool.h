@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int SPLITS_PER_THREAD = 8;            //parallel_for cuts a range into about this many pieces per thread
+const int IDLE_SPINS = 64;                  //empty steal rounds before an idle worker goes to sleep
+const int OUTSIDE_QUEUES = 4;               //threads outside a pool that get a queue of their own; later ones share the last
+
+//a range of a loop: fn(begin, end) once it has been halved down to at most grain items.
+//left counts the items of the whole loop that have not run yet
+struct Task
+{
+	const std::function<void(int, int)> *fn;
+	int begin;
+	int end;
+	int grain;
+	std::atomic<int> *left;
+};
+
+//tasks of one thread. its owner pushes and pops at the back; other threads steal from the front
+struct WorkQueue
+{
+	std::mutex lock;
+	std::deque<Task> tasks;
+};
+
+//work-stealing scheduler over a fixed set of worker threads.
+//each worker has its own queue, and so does each thread outside the pool that uses it (up to
+//OUTSIDE_QUEUES of them). running a task first halves its range, leaving the upper halves on the
+//runner's queue, so an idle thread steals the largest piece left and splits it again itself - long
+//loops spread over every core while short ones stay in few pieces. a thread waiting for its tasks
+//runs the ones on its own queue, and steals only tasks of the loop it waits for, so tasks may start
+//nested loops but a thread waiting on a short loop is never caught up in another thread's long one.
+//the calling thread works too, so a pool of n threads starts n - 1 workers
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkQueue> > queues;    //queue i belongs to worker i, the rest to outside threads
+	std::atomic<int> num_outside;                       //outside threads that have claimed a queue
+	long long serial;                                   //tells pools apart in the outside threads' caches
+	std::atomic<int> queued;                            //tasks in all queues
+	std::atomic<int> sleepers;                          //workers waiting for tasks
+	std::atomic<bool> stopping;
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+
+	void start(int threads);
+	int get_queue();
+	void push(int q, const Task &t);
+	bool pop(int q, Task &t);
+	bool steal(int q, const std::atomic<int> *left, Task &t);
+	bool run_one(int q);
+	void run(int q, Task t);
+	void work(int q);
+
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+
+public:
+	//Constructors
+	ThreadPool();
+	ThreadPool(int threads);
+	~ThreadPool();
+
+	//Getters
+	int get_num_threads() const             { return (int)workers.size() + 1; }
+
+	//Other functions
+	void parallel_for(int n, const std::function<void(int, int)> &fn);
+	void parallel_for(int n, int grain, const std::function<void(int, int)> &fn);
+	void submit(const std::function<void(int, int)> &fn, int begin, int end, int grain, std::atomic<int> &left);
+	void wait(const std::atomic<int> &left);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//stages of a frame and the order they have to run in.
+//run() starts each stage as soon as every stage it depends on has finished, so stages with no path
+//between them overlap. a stage may run a parallel_for on the same pool; the stage's thread helps
+//with the loop and with other ready stages while it waits
+class TaskGraph
+{
+private:
+	std::vector<std::function<void()> > stages;
+	std::vector<std::vector<int> > successors;
+	std::vector<int> num_prerequisites;
+
+	std::unique_ptr<std::atomic<int>[]> waiting;        //per stage, prerequisites still running
+	std::atomic<int> left;                              //stages not finished
+	ThreadPool *running;
+	std::function<void(int, int)> runner;
+
+	TaskGraph(const TaskGraph &);
+	TaskGraph &operator=(const TaskGraph &);
+
+public:
+	//Constructors
+	TaskGraph();
+
+	//Getters
+	int get_num_stages() const              { return (int)stages.size(); }
+
+	//Other functions
+	int add(const std::function<void()> &fn);
+	void depend(int before, int after);
+	void clear();
+	void run(ThreadPool *pool);
+};
@@ -0,0 +1,209 @@
+#include <cstring>
+#include "Transport.h"
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+//Constructor - a hub for n ranks
+LoopbackHub::LoopbackHub(int n)
+{
+	int k;
+
+	size = n>1 ? n : 1;
+	for (k = 0; k<size * size; k++)
+		channels.push_back(std::unique_ptr<Channel>(new Channel()));
+}
+
+//queues a copy of msg from rank from to rank to
+void LoopbackHub::send(int from, int to, const std::vector<char> &msg)
+{
+	Channel &c = *channels[from * size + to];
+
+	{
+		std::lock_guard<std::mutex> guard(c.lock);
+		c.messages.push_back(msg);
+	}
+	c.ready.notify_one();
+}
+
+//waits for the oldest message from rank from to rank to and moves it into msg
+void LoopbackHub::receive(int from, int to, std::vector<char> &msg)
+{
+	Channel &c = *channels[from * size + to];
+	std::unique_lock<std::mutex> guard(c.lock);
+
+	while (c.messages.empty())
+		c.ready.wait(guard);
+	msg.swap(c.messages.front());
+	c.messages.pop_front();
+}
+
+//Constructor
+LoopbackTransport::LoopbackTransport(const std::shared_ptr<LoopbackHub> &h, int r)
+{
+	hub = h;
+	rank = r;
+}
+
+//sends every message before receiving any; the hub's queues never fill, so this cannot deadlock
+bool LoopbackTransport::exchange(const std::vector<int> &peers, const std::vector<std::vector<char> > &out,
+	std::vector<std::vector<char> > &in)
+{
+	int k;
+
+	in.resize(peers.size());
+	for (k = 0; k<(int)peers.size(); k++)
+		hub->send(rank, peers[k], out[k]);
+	for (k = 0; k<(int)peers.size(); k++)
+		hub->receive(peers[k], rank, in[k]);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WIN32)
+
+//connects every pair of size ranks with a socket pair. fds[i * size + j] becomes rank i's end of the
+//connection to rank j (-1 for i == j). returns false, closing whatever was opened, on failure
+bool make_socket_mesh(int size, std::vector<int> &fds)
+{
+	int i, j;
+
+	fds.assign(size * size, -1);
+	for (i = 0; i<size; i++)
+	{
+		for (j = i + 1; j<size; j++)
+		{
+			int sv[2];
+
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+			{
+				for (int k = 0; k<size * size; k++)
+					if (fds[k] >= 0) close(fds[k]);
+				fds.clear();
+				return false;
+			}
+			fds[i * size + j] = sv[0];
+			fds[j * size + i] = sv[1];
+		}
+	}
+	return true;
+}
+
+//Constructor - rank r of the argument mesh, in a process of its own.
+//the ends of the mesh belonging to other ranks are closed
+SocketTransport::SocketTransport(int r, const std::vector<int> &mesh)
+{
+	int i, j;
+
+	rank = r;
+	for (size = 1; size * size<(int)mesh.size(); size++);
+
+	sockets.assign(size, -1);
+	for (i = 0; i<size; i++)
+	{
+		for (j = 0; j<size; j++)
+		{
+			int fd = mesh[i * size + j];
+			if (fd<0) continue;
+
+			if (i == rank)
+			{
+				sockets[j] = fd;
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			}
+			else close(fd);
+		}
+	}
+}
+
+SocketTransport::~SocketTransport()
+{
+	int j;
+
+	for (j = 0; j<size; j++)
+		if (sockets[j] >= 0) close(sockets[j]);
+}
+
+//writes every message, preceded by its length, and reads one from every peer, whichever sockets are
+//ready first. returns false if a peer closed its end or a socket failed
+bool SocketTransport::exchange(const std::vector<int> &peers, const std::vector<std::vector<char> > &out,
+	std::vector<std::vector<char> > &in)
+{
+	int n = (int)peers.size();
+	std::vector<std::vector<char> > framed(n);
+	std::vector<size_t> sent(n, 0);
+	std::vector<size_t> got(n, 0);             //bytes read, the 8 byte length included
+	std::vector<unsigned long long> length(n, 0);
+	std::vector<pollfd> fds;
+	std::vector<int> which;
+	int k;
+
+	in.assign(n, std::vector<char>());
+	for (k = 0; k<n; k++)
+	{
+		unsigned long long len = out[k].size();
+		framed[k].resize(sizeof(len) + out[k].size());
+		memcpy(&framed[k][0], &len, sizeof(len));
+		if (!out[k].empty()) memcpy(&framed[k][sizeof(len)], &out[k][0], out[k].size());
+	}
+
+	for (;;)
+	{
+		fds.clear();
+		which.clear();
+		for (k = 0; k<n; k++)
+		{
+			bool writing = sent[k]<framed[k].size();
+			bool reading = got[k]<sizeof(length[k]) || got[k]<sizeof(length[k]) + length[k];
+			if (!writing && !reading) continue;
+
+			pollfd p = { sockets[peers[k]], (short)((writing ? POLLOUT : 0) | (reading ? POLLIN : 0)), 0 };
+			fds.push_back(p);
+			which.push_back(k);
+		}
+		if (fds.empty()) return true;
+
+		if (poll(&fds[0], fds.size(), -1)<0)
+		{
+			if (errno == EINTR) continue;
+			return false;
+		}
+
+		for (size_t f = 0; f<fds.size(); f++)
+		{
+			k = which[f];
+			int fd = fds[f].fd;
+
+			if (fds[f].revents & POLLOUT)
+			{
+				ssize_t w = send(fd, &framed[k][sent[k]], framed[k].size() - sent[k], MSG_NOSIGNAL);
+				if (w<0 && errno != EAGAIN && errno != EINTR) return false;
+				if (w>0) sent[k] += w;
+			}
+			else if ((fds[f].revents & (POLLHUP | POLLERR)) && !(fds[f].events & POLLIN)) return false;
+
+			if ((fds[f].events & POLLIN) && (fds[f].revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				ssize_t r;
+				if (got[k]<sizeof(length[k]))
+				{
+					r = read(fd, (char *)&length[k] + got[k], sizeof(length[k]) - got[k]);
+					if (r>0 && got[k] + r == sizeof(length[k])) in[k].resize(length[k]);
+				}
+				else r = read(fd, &in[k][got[k] - sizeof(length[k])], sizeof(length[k]) + length[k] - got[k]);
+
+				if (r == 0) return false;
+				if (r<0 && errno != EAGAIN && errno != EINTR) return false;
+				if (r>0) got[k] += r;
+			}
+		}
+	}
+}
+
+#endif
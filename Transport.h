@@ -0,0 +1,112 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//moves messages between the ranks 0 .. size - 1 of a distributed simulation (see Domain).
+//communication happens in rounds: every rank calls exchange() with the peers it talks to that round,
+//sending out[k] to peers[k] and receiving in[k] from it. two ranks must list each other in the same
+//round, and each message arrives in the round it was sent in. returns false if a peer has gone away
+class Transport
+{
+public:
+	//Constructors
+	virtual ~Transport() {}
+
+	//Getters
+	virtual int get_rank() const = 0;
+	virtual int get_size() const = 0;
+
+	//Other functions
+	virtual bool exchange(const std::vector<int> &peers, const std::vector<std::vector<char> > &out,
+		std::vector<std::vector<char> > &in) = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//queues between the ranks of a LoopbackTransport, one per ordered pair of ranks
+class LoopbackHub
+{
+private:
+	struct Channel
+	{
+		std::mutex lock;
+		std::condition_variable ready;
+		std::deque<std::vector<char> > messages;
+	};
+
+	int size;
+	std::vector<std::unique_ptr<Channel> > channels;       //from * size + to
+
+	LoopbackHub(const LoopbackHub &);
+	LoopbackHub &operator=(const LoopbackHub &);
+
+public:
+	//Constructors
+	LoopbackHub(int n);
+
+	//Getters
+	int get_size() const                        { return size; }
+
+	//Other functions
+	void send(int from, int to, const std::vector<char> &msg);
+	void receive(int from, int to, std::vector<char> &msg);
+};
+
+//transport between ranks that are threads of one process, for running and testing a distributed
+//simulation on one machine. every rank gets its own transport on a shared hub
+class LoopbackTransport : public Transport
+{
+private:
+	std::shared_ptr<LoopbackHub> hub;
+	int rank;
+
+public:
+	//Constructors
+	LoopbackTransport(const std::shared_ptr<LoopbackHub> &h, int r);
+
+	//Getters
+	int get_rank() const                        { return rank; }
+	int get_size() const                        { return hub->get_size(); }
+
+	//Other functions
+	bool exchange(const std::vector<int> &peers, const std::vector<std::vector<char> > &out,
+		std::vector<std::vector<char> > &in);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WIN32)
+bool make_socket_mesh(int size, std::vector<int> &fds);
+
+//transport between ranks that are processes on one machine, connected by a mesh of socket pairs.
+//make_socket_mesh() creates the mesh before the processes are forked; each process then builds its
+//transport from it, which closes the ends belonging to other ranks. messages are sent with their
+//length in front, and exchange() reads and writes all peers at once so two ranks sending each other
+//more than a socket buffer cannot block on each other
+class SocketTransport : public Transport
+{
+private:
+	int rank;
+	int size;
+	std::vector<int> sockets;                   //to each rank, -1 for itself
+
+	SocketTransport(const SocketTransport &);
+	SocketTransport &operator=(const SocketTransport &);
+
+public:
+	//Constructors
+	SocketTransport(int r, const std::vector<int> &mesh);
+	~SocketTransport();
+
+	//Getters
+	int get_rank() const                        { return rank; }
+	int get_size() const                        { return size; }
+
+	//Other functions
+	bool exchange(const std::vector<int> &peers, const std::vector<std::vector<char> > &out,
+		std::vector<std::vector<char> > &in);
+};
+#endif
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <functional>
+#include "WallBVH.h"
+
+//stores the axis-aligned bounding box (left, top, right, bottom) of the argument wall in box.
+//the wall spans pt1 +- v_th to pt2 +- v_th
+void get_wall_box(const Wall &w, float *box)
+{
+	sf::Vector2f p1 = w.get_pt1();
+	sf::Vector2f p2 = w.get_pt2();
+	sf::Vector2f th = w.get_thick_vector();
+	float tx = th.x<0 ? -th.x : th.x;
+	float ty = th.y<0 ? -th.y : th.y;
+
+	box[0] = (p1.x<p2.x ? p1.x : p2.x) - tx;
+	box[1] = (p1.y<p2.y ? p1.y : p2.y) - ty;
+	box[2] = (p1.x>p2.x ? p1.x : p2.x) + tx;
+	box[3] = (p1.y>p2.y ? p1.y : p2.y) + ty;
+}
+
+//builds the tree over the n argument walls. query results are indices into this array
+void WallBVH::build(const Wall *ws, int n)
+{
+	int i;
+
+	nodes.clear();
+	order.resize(n);
+	leaf_of.resize(n);
+	wall_box.resize(4 * n);
+
+	for (i = 0; i<n; i++)
+	{
+		order[i] = i;
+		get_wall_box(ws[i], &wall_box[4 * i]);
+	}
+
+	if (n == 0) return;
+
+	nodes.reserve(2 * n / BVH_LEAF_SIZE + 2);
+	nodes.push_back(BVHNode());
+	build_node(0, -1, 0, n);
+	stale.assign(nodes.size(), 0);
+}
+
+//fills the argument node with walls first .. first + count - 1 of the order, splitting it at the
+//median of the longest axis of the wall centres until the pieces fit in a leaf
+void WallBVH::build_node(int node, int parent, int first, int count)
+{
+	int i, a;
+
+	nodes[node].parent = parent;
+	nodes[node].first = first;
+	nodes[node].count = count;
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		for (i = first; i<first + count; i++)
+			leaf_of[order[i]] = node;
+		update_box(node);
+		return;
+	}
+
+	//extent of the wall centres
+	float lo[2] = { 1e30f, 1e30f };
+	float hi[2] = { -1e30f, -1e30f };
+	for (i = first; i<first + count; i++)
+	{
+		const float *b = &wall_box[4 * order[i]];
+		for (a = 0; a<2; a++)
+		{
+			float c = b[a] + b[a + 2];
+			if (c<lo[a]) lo[a] = c;
+			if (c>hi[a]) hi[a] = c;
+		}
+	}
+	int axis = hi[0] - lo[0] >= hi[1] - lo[1] ? 0 : 1;
+
+	const std::vector<float> &boxes = wall_box;
+	std::nth_element(order.begin() + first, order.begin() + first + count / 2, order.begin() + first + count,
+		[&boxes, axis](int u, int v) { return boxes[4 * u + axis] + boxes[4 * u + axis + 2]<boxes[4 * v + axis] + boxes[4 * v + axis + 2]; });
+
+	//the two children are stored next to each other
+	int child = (int)nodes.size();
+	nodes.push_back(BVHNode());
+	nodes.push_back(BVHNode());
+	nodes[node].first = child;
+	nodes[node].count = 0;
+
+	build_node(child, node, first, count / 2);
+	build_node(child + 1, node, first + count / 2, count - count / 2);
+	update_box(node);
+}
+
+//recomputes the box of a node from its walls or its children
+void WallBVH::update_box(int node)
+{
+	BVHNode &nd = nodes[node];
+	const float *b;
+	int i, k;
+
+	if (nd.count>0)
+	{
+		b = &wall_box[4 * order[nd.first]];
+		for (k = 0; k<4; k++) nd.box[k] = b[k];
+
+		for (i = nd.first + 1; i<nd.first + nd.count; i++)
+		{
+			b = &wall_box[4 * order[i]];
+			if (b[0]<nd.box[0]) nd.box[0] = b[0];
+			if (b[1]<nd.box[1]) nd.box[1] = b[1];
+			if (b[2]>nd.box[2]) nd.box[2] = b[2];
+			if (b[3]>nd.box[3]) nd.box[3] = b[3];
+		}
+	}
+	else
+	{
+		const float *l = nodes[nd.first].box;
+		const float *r = nodes[nd.first + 1].box;
+		nd.box[0] = l[0]<r[0] ? l[0] : r[0];
+		nd.box[1] = l[1]<r[1] ? l[1] : r[1];
+		nd.box[2] = l[2]>r[2] ? l[2] : r[2];
+		nd.box[3] = l[3]>r[3] ? l[3] : r[3];
+	}
+}
+
+//updates the tree after wall i of the array passed to build() moved or changed thickness.
+//only the boxes from its leaf up to the root are recomputed
+void WallBVH::refit(const Wall *ws, int i)
+{
+	int node;
+
+	if (i<0 || i >= (int)leaf_of.size()) return;
+	get_wall_box(ws[i], &wall_box[4 * i]);
+
+	for (node = leaf_of[i]; node >= 0; node = nodes[node].parent)
+		update_box(node);
+}
+
+//updates the tree after the n walls listed in which moved. every box on their paths to the root is
+//recomputed once, children before parents (children are always stored after their parent), so
+//refitting walls that share ancestors costs about as much as the nodes they touch
+void WallBVH::refit(const Wall *ws, const int *which, int n)
+{
+	int k, node;
+
+	stale_nodes.clear();
+	for (k = 0; k<n; k++)
+	{
+		int i = which[k];
+		if (i<0 || i >= (int)leaf_of.size()) continue;
+		get_wall_box(ws[i], &wall_box[4 * i]);
+
+		for (node = leaf_of[i]; node >= 0 && !stale[node]; node = nodes[node].parent)
+		{
+			stale[node] = 1;
+			stale_nodes.push_back(node);
+		}
+	}
+
+	std::sort(stale_nodes.begin(), stale_nodes.end(), std::greater<int>());
+	for (k = 0; k<(int)stale_nodes.size(); k++)
+	{
+		update_box(stale_nodes[k]);
+		stale[stale_nodes[k]] = 0;
+	}
+}
+
+//appends the index of every wall whose box overlaps the argument box to the argument vector,
+//in increasing index order so callers visit walls in the same order as a linear scan would
+void WallBVH::query(float left, float top, float right, float bottom, std::vector<int> &found) const
+{
+	int stack[64];
+	int top_of_stack = 0;
+	size_t start = found.size();
+	int i;
+
+	if (nodes.empty()) return;
+	stack[top_of_stack++] = 0;
+
+	while (top_of_stack>0)
+	{
+		const BVHNode &nd = nodes[stack[--top_of_stack]];
+
+		if (left>nd.box[2] || right<nd.box[0] || top>nd.box[3] || bottom<nd.box[1]) continue;
+
+		if (nd.count>0)
+		{
+			for (i = nd.first; i<nd.first + nd.count; i++)
+			{
+				const float *b = &wall_box[4 * order[i]];
+				if (left <= b[2] && right >= b[0] && top <= b[3] && bottom >= b[1])
+					found.push_back(order[i]);
+			}
+		}
+		else
+		{
+			stack[top_of_stack++] = nd.first;
+			stack[top_of_stack++] = nd.first + 1;
+		}
+	}
+
+	std::sort(found.begin() + start, found.end());
+}
+
+//returns whether the ray origin + t * dir, 0 <= t <= max_t, passes through the box (left, top, right, bottom)
+static bool ray_hits_box(const sf::Vector2f &origin, const sf::Vector2f &dir, float max_t, const float *box)
+{
+	float t0 = 0, t1 = max_t;
+	int a;
+
+	for (a = 0; a<2; a++)
+	{
+		float o = a == 0 ? origin.x : origin.y;
+		float d = a == 0 ? dir.x : dir.y;
+		float lo = box[a];
+		float hi = box[a + 2];
+
+		if (d == 0)
+		{
+			if (o<lo || o>hi) return false;
+			continue;
+		}
+
+		float ta = (lo - o) / d;
+		float tb = (hi - o) / d;
+		if (ta>tb) std::swap(ta, tb);
+		if (ta>t0) t0 = ta;
+		if (tb<t1) t1 = tb;
+		if (t0>t1) return false;
+	}
+	return true;
+}
+
+//appends the index of every wall whose box the ray origin + t * dir, 0 <= t <= max_t, passes through
+//to the argument vector, in increasing index order
+void WallBVH::query_ray(sf::Vector2f origin, sf::Vector2f dir, float max_t, std::vector<int> &found) const
+{
+	int stack[64];
+	int top_of_stack = 0;
+	size_t start = found.size();
+	int i;
+
+	if (nodes.empty()) return;
+	stack[top_of_stack++] = 0;
+
+	while (top_of_stack>0)
+	{
+		const BVHNode &nd = nodes[stack[--top_of_stack]];
+
+		if (!ray_hits_box(origin, dir, max_t, nd.box)) continue;
+
+		if (nd.count>0)
+		{
+			for (i = nd.first; i<nd.first + nd.count; i++)
+			{
+				if (ray_hits_box(origin, dir, max_t, &wall_box[4 * order[i]]))
+					found.push_back(order[i]);
+			}
+		}
+		else
+		{
+			stack[top_of_stack++] = nd.first;
+			stack[top_of_stack++] = nd.first + 1;
+		}
+	}
+
+	std::sort(found.begin() + start, found.end());
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include "ball.h"
+
+const int BVH_LEAF_SIZE = 4;            //most walls stored in one leaf
+
+//node of a WallBVH. inner nodes have count == 0 and their children at first and first + 1;
+//leaves list count walls starting at position first of the wall order
+struct BVHNode
+{
+	float box[4];               //left, top, right, bottom
+	int first;
+	int count;
+	int parent;                 //-1 for the root
+};
+
+//bounding volume hierarchy over the axis-aligned boxes of a set of walls.
+//answers "which walls may touch this box" in roughly logarithmic time. when a wall moves or changes
+//thickness, refit() grows/shrinks the boxes on its path to the root instead of rebuilding the tree;
+//the tree only degrades in quality, never in correctness, so rebuild after large changes
+class WallBVH
+{
+private:
+	std::vector<BVHNode> nodes;
+	std::vector<int> order;             //wall indices, grouped by leaf
+	std::vector<int> leaf_of;           //node holding each wall
+	std::vector<float> wall_box;        //4 floats per wall
+	std::vector<unsigned char> stale;   //per node, only set during a refit
+	std::vector<int> stale_nodes;
+
+	void build_node(int node, int parent, int first, int count);
+	void update_box(int node);
+
+public:
+	//Getters
+	int get_num_nodes() const               { return (int)nodes.size(); }
+	int get_num_walls() const               { return (int)leaf_of.size(); }
+
+	//Other functions
+	void build(const Wall *ws, int n);
+	void refit(const Wall *ws, int i);
+	void refit(const Wall *ws, const int *which, int n);
+	void query(float left, float top, float right, float bottom, std::vector<int> &found) const;
+	void query_ray(sf::Vector2f origin, sf::Vector2f dir, float max_t, std::vector<int> &found) const;
+};
+
+void get_wall_box(const Wall &w, float *box);
@@ -0,0 +1,20 @@
+#include "WallRecord.h"
+
+//returns the record of the argument wall
+WallRecord make_wall_record(const Wall &w)
+{
+	WallRecord r = { w.get_pt1().x, w.get_pt1().y, w.get_pt2().x, w.get_pt2().y, w.get_thickness(), w.get_color(),
+		w.get_velocity().x, w.get_velocity().y, w.get_spin(), w.get_pivot() };
+	return r;
+}
+
+//returns the wall the argument record holds, moving as it did
+Wall make_wall(const WallRecord &r)
+{
+	Wall w(sf::Vector2f(r.x1, r.y1), sf::Vector2f(r.x2, r.y2), r.thickness, r.color);
+
+	w.set_pivot(r.pivot);
+	w.set_velocity(sf::Vector2f(r.vx, r.vy));
+	w.set_spin(r.spin);
+	return w;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "ball.h"
+
+//a wall as stored in scenes, replays and cold tiles: its ends, thickness and colour, and its motion.
+//the velocity is that of the pivot, the point the fraction pivot of the way from the first end to the
+//second, and the spin is in degrees per second about it
+struct WallRecord
+{
+	float x1, y1, x2, y2;
+	float thickness;
+	sf::Color color;
+	float vx, vy;
+	float spin;
+	float pivot;
+};
+
+WallRecord make_wall_record(const Wall &w);
+Wall make_wall(const WallRecord &r);
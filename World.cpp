@@ -0,0 +1,1238 @@
+#include <algorithm>
+#include "World.h"
+#include "Profiler.h"
+
+//Default World constructor - an 800x600 arena
+World::World()
+{
+	*this = World(sf::FloatRect(0, 0, 800, 600), FIXED_DT);
+}
+
+//Constructor
+World::World(sf::FloatRect a)
+{
+	*this = World(a, FIXED_DT);
+}
+
+//Primary constructor
+//allows only positive timesteps
+World::World(sf::FloatRect a, float dt)
+{
+	area = a;
+	border = a;
+	grid = Grid(a, 2 * rDefault);
+	sleep_grid = Grid(a, 2 * rDefault);
+
+	fixed_dt = FIXED_DT;
+	set_fixed_dt(dt);
+
+	engine = STEPPED_ENGINE;
+	continuous = false;
+	walls_dirty = true;
+	kinematic_dirty = false;
+	index_walls_stale = true;
+	skin = 0;
+	neighbours_valid = false;
+	coloured_neighbours = false;
+	neighbour_builds = 0;
+	sleeping = false;
+	sleep_dirty = true;
+	num_asleep = 0;
+	sort_interval = 0;
+	steps_since_sort = 0;
+	reordered = false;
+	indexing = false;
+	accumulator = 0;
+	step_count = 0;
+}
+
+//allows only positive timesteps
+void World::set_fixed_dt(float dt)
+{
+	if (dt<0) dt = -dt;
+	if (dt>0) fixed_dt = dt;
+}
+
+//changes the rectangle balls bounce off of; the broad phase grid is resized to match
+void World::set_area(sf::FloatRect a)
+{
+	area = a;
+	border = a;
+	grid.set_area(a);
+	sleep_grid.set_area(a);
+	wake_all();
+}
+
+//makes balls bounce off the argument rectangle instead of the area, which the grid still covers.
+//a world simulating part of a larger one covers its part but bounces off the border of the whole
+void World::set_border(sf::FloatRect b)
+{
+	border = b;
+}
+
+//removes every ball but keeps the walls and the clock. balls are no longer in any kind
+void World::clear_balls()
+{
+	int k;
+
+	balls.clear();
+	for (k = 0; k<(int)kinds.size(); k++)
+		kinds[k]->clear();
+	neighbours_valid = false;
+	steps_since_sort = 0;
+	events.reset();
+	wake_all();
+}
+
+//n > 0 resolves collisions on a pool of n threads (the caller included); n <= 0 goes back to running
+//everything on the calling thread. both collide the pairs in the same coloured batches, so results for a
+//given scene are the same whatever the number of threads
+void World::set_threads(int n)
+{
+	if (n <= 0) pool.reset();
+	else if (!pool || pool->get_num_threads() != n) pool = std::make_shared<ThreadPool>(n);
+}
+
+//makes room for the specified numbers of balls and walls, so adding them does not reallocate
+void World::reserve(int num_balls, int num_walls)
+{
+	balls.reserve(num_balls);
+	walls.reserve(num_walls);
+}
+
+//adds a copy of the argument ball with the behaviour of kind, which is registered with the world the
+//first time it is used, and returns the ball's index. the batch keeps the ball's id
+int World::add_ball(const Ball &b, const std::shared_ptr<BallBatch> &kind)
+{
+	int i = balls.add(b);
+
+	if (std::find(kinds.begin(), kinds.end(), kind) == kinds.end()) kinds.push_back(kind);
+	kind->add(balls.get_id(i));
+	return i;
+}
+
+//adds a ball of a subclass of Ball, whose update_position is called every step (see VirtualBalls),
+//and returns its index. the world keeps the object
+int World::add_ball(std::unique_ptr<Ball> b)
+{
+	int i = balls.add(*b);
+
+	if (!virtual_balls)
+	{
+		virtual_balls = std::make_shared<VirtualBalls>();
+		kinds.push_back(virtual_balls);
+	}
+	virtual_balls->add(balls.get_id(i), std::move(b));
+	return i;
+}
+
+//adds a copy of the argument wall and returns its index
+int World::add_wall(const Wall &w)
+{
+	walls.push_back(w);
+	walls_dirty = true;
+	index_walls_stale = true;
+	if (w.is_kinematic()) kinematic_dirty = true;
+	events.reset();
+	wake_near(w, w);
+	return (int)walls.size() - 1;
+}
+
+//replaces wall i. the wall BVH is refitted rather than rebuilt, and sleeping balls
+//near either the old or the new wall are woken
+void World::set_wall(int i, const Wall &w)
+{
+	Wall old = walls[i];
+
+	walls[i] = w;
+	if (!walls_dirty) wall_bvh.refit(&walls[0], i);
+	index_walls_stale = true;
+	if (old.is_kinematic() != w.is_kinematic()) kinematic_dirty = true;
+	events.reset();
+	wake_near(old, walls[i]);
+}
+
+void World::set_wall_points(int i, sf::Vector2f p1, sf::Vector2f p2)
+{
+	Wall old = walls[i];
+
+	walls[i].set_points(p1, p2);
+	if (!walls_dirty) wall_bvh.refit(&walls[0], i);
+	index_walls_stale = true;
+	events.reset();
+	wake_near(old, walls[i]);
+}
+
+void World::set_wall_thickness(int i, float th)
+{
+	Wall old = walls[i];
+
+	walls[i].set_thickness(th);
+	if (!walls_dirty) wall_bvh.refit(&walls[0], i);
+	index_walls_stale = true;
+	events.reset();
+	wake_near(old, walls[i]);
+}
+
+//makes wall i kinematic, moving at velocity v (pixels per second) and turning about its pivot at
+//spin degrees per second, positive from the x-axis towards the y-axis. zero for both makes it static
+void World::set_wall_motion(int i, sf::Vector2f v, float spin)
+{
+	bool was = walls[i].is_kinematic();
+
+	walls[i].set_velocity(v);
+	walls[i].set_spin(spin);
+	if (was != walls[i].is_kinematic()) kinematic_dirty = true;
+	index_walls_stale = true;
+	events.reset();
+	wake_near(walls[i], walls[i]);
+}
+
+//rebuilds the wall BVH if walls were added or removed since the last step
+void World::update_wall_bvh()
+{
+	if (!walls_dirty) return;
+
+	wall_bvh.build(get_walls(), get_num_walls());
+	walls_dirty = false;
+}
+
+//moves every kinematic wall by one step. the wall BVH is refitted along the moved walls' paths
+//to the root in one pass, and sleeping balls near a moved wall are woken. the event engine's
+//predictions are against the walls where they were, so while any wall moves it starts over each step
+void World::move_walls()
+{
+	int i, k;
+
+	if (kinematic_dirty)
+	{
+		kinematic_walls.clear();
+		for (i = 0; i<(int)walls.size(); i++)
+		{
+			if (walls[i].is_kinematic()) kinematic_walls.push_back(i);
+		}
+		kinematic_dirty = false;
+	}
+	if (kinematic_walls.empty()) return;
+
+	PROFILE_PHASE(WALL_PHASE);
+
+	for (k = 0; k<(int)kinematic_walls.size(); k++)
+	{
+		Wall &w = walls[kinematic_walls[k]];
+
+		if (sleeping && num_asleep>0)
+		{
+			Wall old = w;
+			w.move(fixed_dt);
+			wake_near(old, w);
+		}
+		else w.move(fixed_dt);
+	}
+
+	wall_bvh.refit(&walls[0], &kinematic_walls[0], (int)kinematic_walls.size());
+	index_walls_stale = true;
+	events.reset();
+}
+
+//bounces ball i off the walls near it, found through the wall BVH.
+//candidates is scratch space, so parallel callers can each pass their own
+void World::bounce_off_walls(int i, std::vector<int> &candidates)
+{
+	sf::Vector2f pos = balls.get_position(i);
+	float r = balls.get_radius(i);
+
+	candidates.clear();
+	wall_bvh.query(pos.x - r, pos.y - r, pos.x + r, pos.y + r, candidates);
+	if (!candidates.empty()) balls.bounce_off_walls(i, &walls[0], &candidates[0], (int)candidates.size());
+}
+
+//removes all balls, walls and kinds of balls and resets the clock
+void World::clear()
+{
+	int k;
+
+	balls.clear();
+	walls.clear();
+	for (k = 0; k<(int)kinds.size(); k++)
+		kinds[k]->clear();
+	kinds.clear();
+	virtual_balls.reset();
+	walls_dirty = true;
+	kinematic_dirty = true;
+	index_walls_stale = true;
+	neighbours_valid = false;
+	events.reset();
+	wake_all();
+	accumulator = 0;
+	step_count = 0;
+}
+
+//advances the world by the specified real time in whole fixed steps and returns the number of steps taken.
+//time left over is carried to the next call. if more than MAX_STEPS_PER_CALL steps are owed,
+//the extra time is dropped so a slow frame cannot make the next one slower
+int World::step(sf::Time dT)
+{
+	int steps = 0;
+
+	accumulator += dT.asSeconds();
+
+	while (accumulator >= fixed_dt && steps<MAX_STEPS_PER_CALL)
+	{
+		tick();
+		accumulator -= fixed_dt;
+		steps++;
+	}
+	if (accumulator >= fixed_dt) accumulator = 0;
+
+	return steps;
+}
+
+//advances the world by exactly one fixed step.
+//kinematic walls move first, and are then held still for the rest of the step; balls they now overlap
+//bounce off them with their surface velocity. attraction, if turned on, kicks every velocity by one
+//step's worth of acceleration. the stepped engine then integrates (or sweeps, in continuous mode) and
+//resolves overlaps; the event engine moves from one collision to the next within the step.
+//on a pool, the stages run as a graph: moving the walls overlaps with the forces and with moving the
+//balls whenever those do not read the walls or the sleep state
+void World::tick()
+{
+	reordered = false;
+	if (sort_interval>0 && ++steps_since_sort >= sort_interval) sort_balls();
+	balls.set_contact_step(step_count + 1);
+
+	//the forces and behaviours read the sleep flags, which must first cover balls added since the last step
+	if (sleeping && (field.get_strength() != 0 || !kinds.empty())) update_sleep_lists();
+
+	TaskGraph frame;
+	bool reads_walls = engine == EVENT_ENGINE || continuous || sleeping;
+	int forces = -1;
+	int behaviours = -1;
+	int overlaps = -1;
+
+	int walls_moved = frame.add([this] { update_wall_bvh(); move_walls(); });
+	if (field.get_strength() != 0) forces = frame.add([this] { apply_forces(); });
+	if (!kinds.empty()) behaviours = frame.add([this] { update_kinds(); });
+	int moved = frame.add([this] { move_balls(); });
+	if (engine != EVENT_ENGINE) overlaps = frame.add([this]
+	{
+		if (sleeping && !continuous)
+		{
+			resolve_awake_overlaps();
+			update_sleep(fixed_dt);
+		}
+		else resolve_overlaps();
+	});
+
+	if (sleeping) frame.depend(walls_moved, forces);
+	if (sleeping) frame.depend(walls_moved, behaviours);
+	if (reads_walls) frame.depend(walls_moved, moved);
+	frame.depend(forces, behaviours);
+	frame.depend(forces, moved);
+	frame.depend(behaviours, moved);
+	frame.depend(walls_moved, overlaps);
+	frame.depend(moved, overlaps);
+
+	frame.run(pool.get());
+	step_count++;
+
+	if (indexing) publish_index();
+}
+
+//reorders the balls along a Z-order curve over the area, so balls close together in space are
+//mostly close together in memory and the grid, the pair tests and the wall tests walk the arrays
+//nearly in order. keys are positions quantized to MORTON_BITS bits per axis (balls outside the area
+//are clamped to its edge), sorted with a radix sort on the pool; nothing moves if the balls are
+//already in order. ball indices change - ids do not - and get_sort_order() tells how, until the
+//next tick. neighbour lists are rebuilt in the new order
+void World::sort_balls()
+{
+	int n = balls.size();
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	float sx = area.width>0 ? ((1 << MORTON_BITS) - 1) / area.width : 0;
+	float sy = area.height>0 ? ((1 << MORTON_BITS) - 1) / area.height : 0;
+	int k;
+
+	steps_since_sort = 0;
+	if (n<2) return;
+
+	sort_keys.resize(n);
+	sort_order.resize(n);
+	auto make_keys = [&](int begin, int end)
+	{
+		for (int i = begin; i<end; i++)
+		{
+			float u = (x[i] - area.left) * sx;
+			float v = (y[i] - area.top) * sy;
+			uint32_t cx = u<0 ? 0 : u>(1 << MORTON_BITS) - 1 ? (1 << MORTON_BITS) - 1 : (uint32_t)u;
+			uint32_t cy = v<0 ? 0 : v>(1 << MORTON_BITS) - 1 ? (1 << MORTON_BITS) - 1 : (uint32_t)v;
+
+			sort_keys[i] = morton_key(cx, cy);
+			sort_order[i] = i;
+		}
+	};
+
+	if (pool) pool->parallel_for(n, make_keys);
+	else make_keys(0, n);
+
+	//balls that barely moved since the last sort are often still in order
+	for (k = 1; k<n && sort_keys[k - 1] <= sort_keys[k]; k++);
+	if (k == n) return;
+
+	radix_sort(sort_keys, sort_order, pool.get());
+
+	balls.permute(&sort_order[0]);
+
+	sort_inverse.resize(n);
+	for (k = 0; k<n; k++)
+		sort_inverse[sort_order[k]] = k;
+	reorder_sleep_state();
+
+	neighbours_valid = false;
+	reordered = true;
+	events.reset();
+}
+
+//true makes the world build a SpatialIndex of its balls and walls after every step and publish it
+//through get_spatial_index(), starting with one of the current state; false stops it and drops the index
+void World::set_indexing(bool on)
+{
+	indexing = on;
+	if (on) publish_index();
+	else std::atomic_store(&spatial_index, std::shared_ptr<const SpatialIndex>());
+}
+
+//sends every ball-ball, ball-wall and ball-border impact resolved from now on to the argument stream, which the world
+//keeps alive until unsubscribed. call between steps, not while the world is stepping on another thread
+void World::subscribe(const std::shared_ptr<ContactStream> &s)
+{
+	if (std::find(subscribers.begin(), subscribers.end(), s) != subscribers.end()) return;
+
+	subscribers.push_back(s);
+	balls.add_stream(s.get());
+}
+
+//stops sending impacts to the argument stream; records already in it stay there to be drained
+void World::unsubscribe(const std::shared_ptr<ContactStream> &s)
+{
+	balls.remove_stream(s.get());
+	subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), s), subscribers.end());
+}
+
+//builds an index of the world as it is now and makes it the one get_spatial_index() returns.
+//every step gets a new index: readers keep the one they got for as long as they hold it, and the last
+//of them to let go frees it. the balls are copied on the pool. the walls are shared with the last index
+//if none changed; otherwise they are copied along with the world's wall BVH, which moving walls refit
+//rather than rebuild, and only a BVH made stale by added or removed walls is built again
+void World::publish_index()
+{
+	std::shared_ptr<SpatialIndex> next = std::make_shared<SpatialIndex>();
+	std::shared_ptr<const SpatialIndex> last = std::atomic_load(&spatial_index);
+
+	next->build(balls, area, grid.get_cell_size(), step_count, pool.get());
+	if (last && !index_walls_stale) next->share_walls(*last);
+	else next->set_walls(get_walls(), get_num_walls(), walls_dirty ? 0 : &wall_bvh);
+	index_walls_stale = false;
+	std::atomic_store(&spatial_index, std::shared_ptr<const SpatialIndex>(next));
+}
+
+//applies the last sort to the per-ball sleeping state, first growing it to cover balls added since
+//it was last used. the lists built from it are rebuilt
+void World::reorder_sleep_state()
+{
+	int n = balls.size();
+	std::vector<unsigned char> a(n);
+	std::vector<float> r(n);
+	std::vector<int> next(n);
+	int k;
+
+	asleep.resize(n, 0);
+	rest_time.resize(n, 0);
+	for (k = (int)island_next.size(); k<n; k++)
+		island_next.push_back(k);
+
+	for (k = 0; k<n; k++)
+	{
+		a[k] = asleep[sort_order[k]];
+		r[k] = rest_time[sort_order[k]];
+		next[k] = sort_inverse[island_next[sort_order[k]]];
+	}
+	asleep.swap(a);
+	rest_time.swap(r);
+	island_next.swap(next);
+
+	woken.clear();
+	sleep_dirty = true;
+}
+
+//moves the balls through the step: the event engine resolving every collision on the way, or the
+//stepped engine integrating (or sweeping) and bouncing off the border, on the pool if there is one
+void World::move_balls()
+{
+	if (engine == EVENT_ENGINE)
+	{
+		//events only see walls a ball sweeps into, not walls that moved onto it
+		if (!kinematic_walls.empty()) bounce_all_off_walls();
+
+		PROFILE_PHASE(INTEGRATE_PHASE);
+		events.advance(balls, get_walls(), get_num_walls(), &wall_bvh, border, fixed_dt);
+	}
+	else if (continuous)
+	{
+		PROFILE_PHASE(INTEGRATE_PHASE);
+		sweep(fixed_dt);
+	}
+	else if (sleeping)
+	{
+		update_sleep_lists();
+		{
+			PROFILE_PHASE(INTEGRATE_PHASE);
+			balls.integrate(fixed_dt, awake_balls.empty() ? 0 : &awake_balls[0], (int)awake_balls.size());
+		}
+		PROFILE_PHASE(BORDER_PHASE);
+		balls.bounce_off_border(border, awake_balls.empty() ? 0 : &awake_balls[0], (int)awake_balls.size());
+	}
+	else if (pool)
+	{
+		{
+			PROFILE_PHASE(INTEGRATE_PHASE);
+			pool->parallel_for(balls.size(), [&](int begin, int end) { balls.integrate(fixed_dt, begin, end); });
+		}
+		PROFILE_PHASE(BORDER_PHASE);
+		pool->parallel_for(balls.size(), [&](int begin, int end) { balls.bounce_off_border(border, begin, end); });
+	}
+	else
+	{
+		{
+			PROFILE_PHASE(INTEGRATE_PHASE);
+			balls.integrate(fixed_dt);
+		}
+		PROFILE_PHASE(BORDER_PHASE);
+		balls.bounce_off_border(border);
+	}
+}
+
+//builds the force field's tree and kicks each ball's velocity by its acceleration over one step,
+//on the pool if there is one. sleeping balls still attract but are not moved
+void World::apply_forces()
+{
+	PROFILE_PHASE(FORCE_PHASE);
+
+	const unsigned char *frozen = sleeping && num_asleep>0 ? &asleep[0] : 0;
+
+	field.build(balls);
+
+	if (pool)
+	{
+		pool->parallel_for(field.get_num_leaves(), [&](int begin, int end)
+		{
+			field.apply(balls, begin, end, fixed_dt, frozen);
+		});
+	}
+	else field.apply(balls, 0, field.get_num_leaves(), fixed_dt, frozen);
+}
+
+//runs the behaviour of every kind of ball over its balls, one kind after another since a ball may
+//belong to several, each on the pool if there is one. sleeping balls are left alone
+void World::update_kinds()
+{
+	PROFILE_PHASE(FORCE_PHASE);
+
+	const unsigned char *frozen = sleeping && num_asleep>0 ? &asleep[0] : 0;
+	int k;
+
+	for (k = 0; k<(int)kinds.size(); k++)
+	{
+		BallBatch &kind = *kinds[k];
+
+		if (pool) pool->parallel_for(kind.size(), [&](int begin, int end) { kind.update(balls, begin, end, fixed_dt, frozen); });
+		else kind.update(balls, 0, kind.size(), fixed_dt, frozen);
+	}
+}
+
+//discrete narrow phase: collides every pair of overlapping balls and bounces balls off the walls they overlap
+void World::resolve_overlaps()
+{
+	if (skin>0)
+	{
+		resolve_neighbour_overlaps();
+		return;
+	}
+	if (pool)
+	{
+		resolve_overlaps_parallel();
+		return;
+	}
+
+	{
+		PROFILE_PHASE(BALL_PHASE);
+
+		//broad phase: only balls sharing a grid cell are tested against each other
+		grid.rebuild(balls.get_x(), balls.get_y(), balls.get_radii(), balls.size());
+		pairs.clear();
+		grid.find_pairs(pairs);
+		colour_pairs(pairs);
+		collide_coloured();
+	}
+
+	bounce_all_off_walls();
+}
+
+//bounces every ball off the walls it overlaps, on the pool if there is one
+void World::bounce_all_off_walls()
+{
+	int i;
+
+	PROFILE_PHASE(WALL_PHASE);
+	if (walls.empty()) return;
+
+	if (pool)
+	{
+		pool->parallel_for(balls.size(), [&](int begin, int end)
+		{
+			std::vector<int> candidates;
+			for (int i = begin; i<end; i++)
+				bounce_off_walls(i, candidates);
+		});
+	}
+	else
+	{
+		for (i = 0; i<balls.size(); i++)
+			bounce_off_walls(i, wall_candidates);
+	}
+}
+
+//skin > 0 replaces the per-step broad phase of the stepped engine with neighbour lists: every pair of
+//balls closer than their radii plus skin is cached, and the cache is only rebuilt once some ball has
+//moved more than skin / 2 since it was built, before which no other pair can have come into contact.
+//larger skins rebuild less often but test more pairs per step. skin <= 0 goes back to the grid.
+//changing radii through get_balls() is not noticed; setting the skin again forces a rebuild.
+//while sleeping is on (outside continuous mode) the awake balls are paired through their own grids
+//and the skin is kept but not used; it applies again once sleeping is turned off
+void World::set_neighbour_skin(float s)
+{
+	skin = s>0 ? s : 0;
+	neighbours_valid = false;
+}
+
+//true if the neighbour list has to be rebuilt before it can be used for this step
+bool World::neighbours_stale() const
+{
+	int n = balls.size();
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	float limit = skin * skin / 4;
+	int i;
+
+	if (!neighbours_valid || (int)built_x.size() != n) return true;
+
+	for (i = 0; i<n; i++)
+	{
+		float dx = x[i] - built_x[i];
+		float dy = y[i] - built_y[i];
+		if (dx*dx + dy*dy > limit) return true;
+	}
+	return false;
+}
+
+//rebuilds the neighbour list from a grid over the balls grown by skin / 2,
+//keeping the candidate pairs whose centres are within their radii plus skin
+void World::build_neighbours()
+{
+	int n = balls.size();
+	const float *x = balls.get_x();
+	const float *y = balls.get_y();
+	const float *r = balls.get_radii();
+	int i, k;
+
+	grown_r.resize(n);
+	for (i = 0; i<n; i++)
+		grown_r[i] = r[i] + skin / 2;
+
+	grid.rebuild(x, y, grown_r.empty() ? 0 : &grown_r[0], n);
+	pairs.clear();
+	grid.find_pairs(pairs);
+
+	neighbours.clear();
+	for (k = 0; k<(int)pairs.size(); k++)
+	{
+		int a = pairs[k].a;
+		int b = pairs[k].b;
+		float dx = x[b] - x[a];
+		float dy = y[b] - y[a];
+		float reach = r[a] + r[b] + skin;
+
+		if (dx*dx + dy*dy < reach*reach) neighbours.push_back(pairs[k]);
+	}
+
+	built_x.assign(x, x + n);
+	built_y.assign(y, y + n);
+	neighbours_valid = true;
+	coloured_neighbours = false;
+	neighbour_builds++;
+}
+
+//resolve_overlaps with the cached neighbour list in place of the grid. on the pool, the list is
+//only sorted into colour classes when it is rebuilt
+void World::resolve_neighbour_overlaps()
+{
+	{
+		PROFILE_PHASE(BALL_PHASE);
+
+		if (neighbours_stale()) build_neighbours();
+
+		if (!coloured_neighbours) colour_pairs(neighbours);
+		collide_coloured();
+	}
+
+	bounce_all_off_walls();
+}
+
+//sorts the candidate pairs into colour classes in which no ball appears twice, so each class can be
+//collided in parallel without two threads writing the same ball. colours are assigned greedily in
+//pair order, which depends only on the scene, never on the number of threads. pairs whose balls
+//already use all PAIR_COLOURS colours go into a last class that is resolved serially
+void World::colour_pairs(const std::vector<CandidatePair> &ps)
+{
+	int n = balls.size();
+	int np = (int)ps.size();
+	int k, c;
+
+	colour_masks.assign(n, 0);
+	colour_start.assign(PAIR_COLOURS + 2, 0);
+	pair_colour.resize(np);
+
+	for (k = 0; k<np; k++)
+	{
+		unsigned long long used = colour_masks[ps[k].a] | colour_masks[ps[k].b];
+
+		for (c = 0; c<PAIR_COLOURS && (used >> c & 1); c++);
+		if (c<PAIR_COLOURS)
+		{
+			colour_masks[ps[k].a] |= 1ULL << c;
+			colour_masks[ps[k].b] |= 1ULL << c;
+		}
+		pair_colour[k] = (unsigned char)c;
+		colour_start[c + 1]++;
+	}
+
+	for (c = 0; c<PAIR_COLOURS + 1; c++)
+		colour_start[c + 1] += colour_start[c];
+
+	colour_fill.assign(colour_start.begin(), colour_start.end() - 1);
+	coloured.resize(np);
+	for (k = 0; k<np; k++)
+		coloured[colour_fill[pair_colour[k]]++] = ps[k];
+
+	coloured_neighbours = &ps == &neighbours;
+}
+
+//collides the pairs sorted by colour_pairs one colour class at a time, each split across the pool if
+//there is one. no ball is in two pairs of a class, so the split does not change the result.
+//each pair's overlap test result goes to its own slot of hits, so the ranges share it safely
+void World::collide_coloured()
+{
+	int c;
+
+	if (coloured.empty()) return;
+	if (hits.size()<coloured.size()) hits.resize(coloured.size());
+
+	for (c = 0; c<PAIR_COLOURS; c++)
+	{
+		CandidatePair *batch = coloured.data() + colour_start[c];
+		unsigned char *batch_hits = hits.data() + colour_start[c];
+		int num = colour_start[c + 1] - colour_start[c];
+
+		if (num == 0) continue;
+		if (pool) pool->parallel_for(num, [&](int begin, int end) { balls.collide(batch + begin, end - begin, batch_hits + begin); });
+		else balls.collide(batch, num, batch_hits);
+	}
+	if (colour_start[PAIR_COLOURS + 1]>colour_start[PAIR_COLOURS])
+		balls.collide(coloured.data() + colour_start[PAIR_COLOURS], colour_start[PAIR_COLOURS + 1] - colour_start[PAIR_COLOURS], hits.data() + colour_start[PAIR_COLOURS]);
+}
+
+//parallel version of resolve_overlaps: finds pairs over ranges of grid cells, collides one colour
+//class at a time with each class split across the pool, then bounces each ball off the walls
+void World::resolve_overlaps_parallel()
+{
+	int threads = pool->get_num_threads();
+	int num_cells = grid.get_cols() * grid.get_rows();
+	int ranges = 4 * threads;
+	int k;
+
+	{
+		PROFILE_PHASE(BALL_PHASE);
+
+		grid.rebuild(balls.get_x(), balls.get_y(), balls.get_radii(), balls.size());
+
+		range_pairs.resize(ranges);
+		pool->parallel_for(ranges, [&](int begin, int end)
+		{
+			for (int r = begin; r<end; r++)
+			{
+				range_pairs[r].clear();
+				grid.find_pairs(range_pairs[r], (int)((long long)num_cells * r / ranges), (int)((long long)num_cells * (r + 1) / ranges));
+			}
+		});
+
+		pairs.clear();
+		for (k = 0; k<ranges; k++)
+			pairs.insert(pairs.end(), range_pairs[k].begin(), range_pairs[k].end());
+
+		colour_pairs(pairs);
+		collide_coloured();
+	}
+
+	bounce_all_off_walls();
+}
+
+//moves ball i along its velocity from its local time to time t of the current continuous step
+void World::advance_ball(int i, float t)
+{
+	balls.set_position(i, balls.get_position(i) + (t - local_t[i]) * balls.get_velocity(i));
+	local_t[i] = t;
+}
+
+//orders impacts by time, then by the balls involved so ties are always processed the same way
+bool impact_before(const Impact &e, const Impact &f)
+{
+	if (e.t != f.t) return e.t<f.t;
+	if (e.a != f.a) return e.a<f.a;
+	if (e.type != f.type) return e.type<f.type;
+	return e.b<f.b;
+}
+
+//continuous integration: moves every ball dt seconds, stopping at each predicted time of impact
+//against other balls, walls and the border to resolve it there.
+//each pass predicts impacts for the balls whose velocity changed in the previous pass (all balls
+//in the first), then resolves them in time order; a ball takes part in at most one impact per pass,
+//since its later predictions are stale once its velocity changes. after MAX_CCD_PASSES passes the
+//remaining motion is integrated directly and left to the discrete narrow phase
+void World::sweep(float dt)
+{
+	int n = balls.size();
+	int i, k, pass;
+
+	local_t.assign(n, 0);
+	active.assign(n, 1);
+	swept_x.resize(n);
+	swept_y.resize(n);
+	swept_r.resize(n);
+
+	for (pass = 0; pass<MAX_CCD_PASSES; pass++)
+	{
+		impacts.clear();
+
+		//bounding circle of what is left of each ball's path
+		for (i = 0; i<n; i++)
+		{
+			sf::Vector2f half = (dt - local_t[i]) / 2 * balls.get_velocity(i);
+			swept_x[i] = balls.get_position(i).x + half.x;
+			swept_y[i] = balls.get_position(i).y + half.y;
+			swept_r[i] = balls.get_radius(i) + magnitude(half);
+		}
+
+		if (n>0) grid.rebuild(&swept_x[0], &swept_y[0], &swept_r[0], n);
+		pairs.clear();
+		grid.find_pairs(pairs);
+
+		for (k = 0; k<(int)pairs.size(); k++)
+		{
+			int a = pairs[k].a;
+			int b = pairs[k].b;
+			if (!active[a] && !active[b]) continue;
+
+			float t0 = local_t[a]>local_t[b] ? local_t[a] : local_t[b];
+			sf::Vector2f pa = balls.get_position(a) + (t0 - local_t[a]) * balls.get_velocity(a);
+			sf::Vector2f pb = balls.get_position(b) + (t0 - local_t[b]) * balls.get_velocity(b);
+			float r = balls.get_radius(a) + balls.get_radius(b);
+			if (r>2 * CONTACT_SLOP) r -= CONTACT_SLOP;
+
+			float t = sweep_circle(pb - pa, balls.get_velocity(b) - balls.get_velocity(a), r, dt - t0);
+			if (t >= 0)
+			{
+				Impact e = { t0 + t, BALL_IMPACT, a, b };
+				impacts.push_back(e);
+			}
+		}
+
+		for (i = 0; i<n; i++)
+		{
+			if (!active[i]) continue;
+
+			sf::Vector2f pos = balls.get_position(i);
+			sf::Vector2f vel = balls.get_velocity(i);
+			float r = balls.get_radius(i);
+			float rest = dt - local_t[i];
+			float t;
+			if (r>2 * CONTACT_SLOP) r -= CONTACT_SLOP;
+
+			//walls near the path, i.e. overlapping the box around both ends of it
+			sf::Vector2f end = pos + rest * vel;
+			float reach = balls.get_radius(i);
+			wall_candidates.clear();
+			wall_bvh.query((pos.x<end.x ? pos.x : end.x) - reach, (pos.y<end.y ? pos.y : end.y) - reach,
+				(pos.x>end.x ? pos.x : end.x) + reach, (pos.y>end.y ? pos.y : end.y) + reach, wall_candidates);
+
+			for (k = 0; k<(int)wall_candidates.size(); k++)
+			{
+				t = sweep_wall(walls[wall_candidates[k]], pos, vel, r, rest);
+				if (t >= 0)
+				{
+					Impact e = { local_t[i] + t, WALL_IMPACT, i, wall_candidates[k] };
+					impacts.push_back(e);
+				}
+			}
+
+			bool x_side;
+			t = sweep_border(border, pos, vel, r, rest, x_side);
+			if (t >= 0)
+			{
+				Impact e = { local_t[i] + t, x_side ? BORDER_X_IMPACT : BORDER_Y_IMPACT, i, 0 };
+				impacts.push_back(e);
+			}
+		}
+
+		if (impacts.empty()) break;
+		std::sort(impacts.begin(), impacts.end(), impact_before);
+
+		active.assign(n, 0);
+		for (k = 0; k<(int)impacts.size(); k++)
+		{
+			const Impact &e = impacts[k];
+			if (active[e.a] || (e.type == BALL_IMPACT && active[e.b])) continue;
+
+			advance_ball(e.a, e.t);
+			active[e.a] = 1;
+
+			switch (e.type)
+			{
+			case BALL_IMPACT:
+				advance_ball(e.b, e.t);
+				active[e.b] = 1;
+				balls.collide(e.a, e.b);
+				break;
+
+			case WALL_IMPACT:
+				balls.bounce_off_walls(e.a, &walls[0], &e.b, 1);
+				break;
+
+			case BORDER_X_IMPACT:
+				balls.bounce_off_border_x(e.a, border);
+				break;
+
+			case BORDER_Y_IMPACT:
+				balls.bounce_off_border_y(e.a, border);
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i<n; i++)
+		advance_ball(i, dt);
+
+	balls.bounce_off_border(border);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//true lets the stepped engine put resting balls to sleep. balls are grouped into islands of balls
+//whose bounding boxes overlap, and an island sleeps once all of its balls have been slower than
+//SLEEP_SPEED for SLEEP_DELAY seconds; its velocities are then zeroed. sleeping balls are skipped by
+//integration, the border and the pair and wall tests, and wake up (with their whole island) when an
+//awake ball collides with them or a wall near them changes. continuous mode and the event engine
+//ignore sleep, and switching to or from either wakes every ball. turning it off wakes every ball and
+//makes the neighbour lists, if any, be rebuilt from the balls' current positions
+void World::set_sleeping(bool s)
+{
+	if (!s)
+	{
+		wake_all();
+		neighbours_valid = false;
+	}
+	sleeping = s;
+}
+
+//in continuous mode balls are swept to their time of impact instead of being tested for overlap at the
+//end of the step. sleep flags would go stale while it ignores them, so changing mode wakes every ball
+void World::set_continuous(bool c)
+{
+	if (c != continuous) wake_all();
+	continuous = c;
+}
+
+//the stepped engine integrates every ball through the step and then resolves overlaps; the event engine
+//moves from one collision to the next within it. the event engine ignores sleep, so changing engine
+//wakes every ball as continuous mode does
+void World::set_engine(Engine e)
+{
+	if (e != engine)
+	{
+		wake_all();
+		events.reset();
+	}
+	engine = e;
+}
+
+//wakes ball i and the island it fell asleep with
+void World::wake(int i)
+{
+	if (is_asleep(i)) wake_island(i);
+}
+
+void World::wake_all()
+{
+	int i;
+
+	asleep.assign(balls.size(), 0);
+	rest_time.assign(balls.size(), 0);
+	island_next.resize(balls.size());
+	for (i = 0; i<balls.size(); i++)
+		island_next[i] = i;
+
+	woken.clear();
+	num_asleep = 0;
+	sleep_dirty = true;
+}
+
+//copies the positions and radii of the argument balls into sub_x, sub_y and sub_r
+void World::gather(const std::vector<int> &which)
+{
+	int n = (int)which.size();
+	int k;
+
+	sub_x.resize(n);
+	sub_y.resize(n);
+	sub_r.resize(n);
+	for (k = 0; k<n; k++)
+	{
+		sub_x[k] = balls.get_x()[which[k]];
+		sub_y[k] = balls.get_y()[which[k]];
+		sub_r[k] = balls.get_radius(which[k]);
+	}
+}
+
+//brings the awake and sleeping lists and the grid of sleeping balls up to date.
+//balls added since the last call start out awake. balls that only woke up are appended to the
+//awake list and left in the sleeping grid, where the asleep flags mark them stale; everything is
+//rebuilt when balls fell asleep or were added, or when more than half of the sleeping list is stale
+void World::update_sleep_lists()
+{
+	int n = balls.size();
+	int i;
+
+	if (!sleep_dirty && 2 * (int)woken.size() <= (int)sleeping_balls.size())
+	{
+		awake_balls.insert(awake_balls.end(), woken.begin(), woken.end());
+		woken.clear();
+	}
+	else sleep_dirty = true;
+
+	if ((int)asleep.size() != n)
+	{
+		asleep.resize(n, 0);
+		rest_time.resize(n, 0);
+		for (i = (int)island_next.size(); i<n; i++)
+			island_next.push_back(i);
+		sleep_dirty = true;
+	}
+	if (!sleep_dirty) return;
+
+	awake_balls.clear();
+	sleeping_balls.clear();
+	woken.clear();
+	for (i = 0; i<n; i++)
+	{
+		if (asleep[i]) sleeping_balls.push_back(i);
+		else awake_balls.push_back(i);
+	}
+
+	gather(sleeping_balls);
+	sleep_grid.rebuild(sub_x.empty() ? 0 : &sub_x[0], sub_y.empty() ? 0 : &sub_y[0], sub_r.empty() ? 0 : &sub_r[0], (int)sleeping_balls.size());
+	sleep_dirty = false;
+}
+
+//resolve_overlaps for the awake balls: pairs of awake balls come from the regular grid built over them
+//alone, and awake balls are tested against sleeping ones through the sleeping grid. a sleeping ball
+//that an awake one actually pushes wakes up with its island
+void World::resolve_awake_overlaps()
+{
+	int na = (int)awake_balls.size();
+	int k;
+
+	{
+		PROFILE_PHASE(BALL_PHASE);
+
+		gather(awake_balls);
+		grid.rebuild(sub_x.empty() ? 0 : &sub_x[0], sub_y.empty() ? 0 : &sub_y[0], sub_r.empty() ? 0 : &sub_r[0], na);
+		pairs.clear();
+		grid.find_pairs(pairs);
+		for (k = 0; k<(int)pairs.size(); k++)
+		{
+			pairs[k].a = awake_balls[pairs[k].a];
+			pairs[k].b = awake_balls[pairs[k].b];
+		}
+
+		colour_pairs(pairs);
+		collide_coloured();
+
+		cross_pairs.clear();
+		if (!sleeping_balls.empty())
+		{
+			for (k = 0; k<na; k++)
+			{
+				int i = awake_balls[k];
+				sf::Vector2f pos = balls.get_position(i);
+				float r = balls.get_radius(i);
+				int f;
+
+				found.clear();
+				sleep_grid.query(pos.x - r, pos.y - r, pos.x + r, pos.y + r, found);
+				for (f = 0; f<(int)found.size(); f++)
+				{
+					CandidatePair p = { i, sleeping_balls[found[f]] };
+					if (asleep[p.b]) cross_pairs.push_back(p);
+				}
+			}
+		}
+
+		hits.resize(cross_pairs.size());
+		if (!cross_pairs.empty()) balls.test_overlaps(&cross_pairs[0], (int)cross_pairs.size(), &hits[0]);
+		for (k = 0; k<(int)cross_pairs.size(); k++)
+		{
+			int b = cross_pairs[k].b;
+			if (hits[k] && balls.collide(cross_pairs[k].a, b) && asleep[b]) wake_island(b);
+		}
+	}
+
+	PROFILE_PHASE(WALL_PHASE);
+	if (!walls.empty())
+	{
+		if (pool)
+		{
+			pool->parallel_for(na, [&](int begin, int end)
+			{
+				std::vector<int> candidates;
+				for (int k = begin; k<end; k++)
+					bounce_off_walls(awake_balls[k], candidates);
+			});
+		}
+		else
+		{
+			for (k = 0; k<na; k++)
+				bounce_off_walls(awake_balls[k], wall_candidates);
+		}
+	}
+}
+
+//root of ball i's island in the union-find forest, halving paths on the way
+int World::find_island(int i)
+{
+	while (island_parent[i] != i)
+	{
+		island_parent[i] = island_parent[island_parent[i]];
+		i = island_parent[i];
+	}
+	return i;
+}
+
+//updates how long each awake ball has been resting. every SLEEP_CHECK_STEPS steps, also joins the
+//balls of this step's candidate pairs into islands and puts to sleep every island whose balls have
+//all rested for SLEEP_DELAY. balls woken during this step are left out until the next check
+void World::update_sleep(float dt)
+{
+	int na = (int)awake_balls.size();
+	int k;
+
+	island_parent.resize(balls.size());
+	island_rest.resize(balls.size());
+
+	for (k = 0; k<na; k++)
+	{
+		int i = awake_balls[k];
+		sf::Vector2f v = balls.get_velocity(i);
+
+		if (v.x*v.x + v.y*v.y < SLEEP_SPEED*SLEEP_SPEED) rest_time[i] += dt;
+		else rest_time[i] = 0;
+
+		island_parent[i] = i;
+		island_rest[i] = rest_time[i];
+	}
+	if (step_count % SLEEP_CHECK_STEPS != 0) return;
+
+	for (k = 0; k<(int)pairs.size(); k++)
+	{
+		int a = find_island(pairs[k].a);
+		int b = find_island(pairs[k].b);
+
+		if (a == b) continue;
+		if (a>b) std::swap(a, b);
+		island_parent[b] = a;
+		if (island_rest[b]<island_rest[a]) island_rest[a] = island_rest[b];
+	}
+
+	for (k = 0; k<na; k++)
+	{
+		int i = awake_balls[k];
+		int root = find_island(i);
+
+		if (island_rest[root]<SLEEP_DELAY || asleep[i]) continue;
+
+		//awake balls are lists of their own, so the island is spliced together around its root
+		asleep[i] = 1;
+		balls.set_velocity(i, sf::Vector2f(0, 0));
+		if (i != root)
+		{
+			island_next[i] = island_next[root];
+			island_next[root] = i;
+		}
+
+		num_asleep++;
+		sleep_dirty = true;
+	}
+}
+
+//wakes every ball of the island ball i fell asleep with
+void World::wake_island(int i)
+{
+	int j = i;
+
+	do
+	{
+		int next = island_next[j];
+
+		asleep[j] = 0;
+		rest_time[j] = 0;
+		island_next[j] = j;
+		woken.push_back(j);
+		num_asleep--;
+		j = next;
+	} while (j != i);
+}
+
+//wakes the islands of the sleeping balls whose bounding boxes overlap the argument box
+void World::wake_near(float left, float top, float right, float bottom)
+{
+	int f;
+
+	if (!sleeping || num_asleep == 0) return;
+
+	update_sleep_lists();
+	found.clear();
+	sleep_grid.query(left, top, right, bottom, found);
+	for (f = 0; f<(int)found.size(); f++)
+	{
+		if (asleep[sleeping_balls[found[f]]]) wake_island(sleeping_balls[found[f]]);
+	}
+}
+
+//wakes the islands near a wall that changed from w to v
+void World::wake_near(const Wall &w, const Wall &v)
+{
+	float a[4], b[4];
+
+	get_wall_box(w, a);
+	get_wall_box(v, b);
+	wake_near(a[0]<b[0] ? a[0] : b[0], a[1]<b[1] ? a[1] : b[1], a[2]>b[2] ? a[2] : b[2], a[3]>b[3] ? a[3] : b[3]);
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "ball.h"
+#include "BallSystem.h"
+#include "Grid.h"
+#include "EventEngine.h"
+#include "ThreadPool.h"
+#include "WallBVH.h"
+#include "ForceField.h"
+#include "Morton.h"
+#include "BallKind.h"
+#include "SpatialIndex.h"
+
+const float FIXED_DT = 1.0f / 240;          //default physics timestep, in seconds
+const int MAX_STEPS_PER_CALL = 16;          //step() drops time it would need more fixed steps than this for
+
+const int PAIR_COLOURS = 64;                //colour classes for parallel collisions; pairs that fit none are resolved serially
+
+const int MAX_CCD_PASSES = 4;               //impact passes per step in continuous mode before falling back to discrete tests
+
+const float SLEEP_SPEED = 2.0f;             //balls slower than this, in pixels per second, count as resting
+const float SLEEP_DELAY = 0.5f;             //seconds every ball of an island has to rest before the island sleeps
+const int SLEEP_CHECK_STEPS = 16;           //islands are only put to sleep every this many steps, so the sleeping grid is rarely rebuilt
+
+const int SORT_INTERVAL = 64;               //suggested steps between reorderings of the balls by position
+
+enum Engine { STEPPED_ENGINE, EVENT_ENGINE };      //see World::set_engine
+
+enum ImpactType { BALL_IMPACT, WALL_IMPACT, BORDER_X_IMPACT, BORDER_Y_IMPACT };
+
+//a predicted contact during a continuous step
+struct Impact
+{
+	float t;                //time since the start of the step
+	ImpactType type;
+	int a;                  //ball index
+	int b;                  //other ball or wall index, unused for the border
+};
+
+//a bounded arena of balls and walls, advanced with a fixed timestep.
+//step() accumulates real elapsed time and runs as many whole fixed steps as fit,
+//so results do not depend on the frame rate and no window is needed to simulate
+class World
+{
+private:
+	sf::FloatRect area;             //covered by the grids
+	sf::FloatRect border;           //balls bounce off the sides of this rectangle; the area unless set apart
+	BallSystem balls;
+	std::vector<Wall> walls;
+	WallBVH wall_bvh;
+	bool walls_dirty;               //walls were added or removed since wall_bvh was built
+	std::vector<int> wall_candidates;
+	std::vector<int> kinematic_walls;       //walls moved at the start of every step
+	bool kinematic_dirty;                   //a wall's motion may have changed since kinematic_walls was listed
+
+	Grid grid;
+	std::vector<CandidatePair> pairs;
+
+	std::shared_ptr<ThreadPool> pool;                       //null when running on the calling thread only
+	std::vector<std::vector<CandidatePair> > range_pairs;  //pairs found by each range of grid cells
+	std::vector<unsigned long long> colour_masks;          //per ball: colours already holding one of its pairs
+	std::vector<CandidatePair> coloured;                    //pairs sorted by colour, in their original order
+	std::vector<int> colour_start;                          //PAIR_COLOURS + 2 offsets into coloured
+	std::vector<unsigned char> pair_colour;                 //colour of each pair, while sorting them
+	std::vector<int> colour_fill;                           //next free place of each colour, while sorting
+
+	float skin;                     //neighbour lists are used when > 0, see set_neighbour_skin
+	bool neighbours_valid;
+	bool coloured_neighbours;       //coloured holds the neighbour list
+	long long neighbour_builds;
+	std::vector<CandidatePair> neighbours;
+	std::vector<float> built_x;     //ball positions when the neighbour list was built
+	std::vector<float> built_y;
+	std::vector<float> grown_r;
+
+	Engine engine;
+	EventEngine events;
+	ForceField field;               //mutual attraction, applied before each step when its strength is nonzero
+	std::vector<std::shared_ptr<BallBatch> > kinds;     //behaviours of some of the balls, see add_ball
+	std::shared_ptr<VirtualBalls> virtual_balls;        //balls added as objects, null until there is one
+	std::vector<std::shared_ptr<ContactStream> > subscribers;
+
+	bool continuous;                //sweep balls to their time of impact instead of testing overlaps only
+	std::vector<Impact> impacts;
+	std::vector<float> local_t;     //per-ball time reached within the current continuous step
+	std::vector<float> swept_x;     //bounding circle of the rest of each ball's path
+	std::vector<float> swept_y;
+	std::vector<float> swept_r;
+	std::vector<unsigned char> active;
+
+	bool sleeping;                  //see set_sleeping
+	bool sleep_dirty;               //balls fell asleep or were added since the lists below were built
+	int num_asleep;
+	std::vector<unsigned char> asleep;
+	std::vector<float> rest_time;   //per ball: seconds it has been slower than SLEEP_SPEED
+	std::vector<int> island_next;   //circular lists through the balls that fell asleep together
+	std::vector<int> island_parent; //union-find forest over the awake balls, rebuilt every step
+	std::vector<float> island_rest; //per island root: shortest rest_time of its balls
+	std::vector<int> awake_balls;
+	std::vector<int> sleeping_balls;        //can still hold balls woken since it was built
+	std::vector<int> woken;                 //balls woken since the awake list was last updated
+	Grid sleep_grid;                //over sleeping_balls; only rebuilt when the set changes
+	std::vector<float> sub_x;       //positions and radii gathered from a subset of the balls
+	std::vector<float> sub_y;
+	std::vector<float> sub_r;
+	std::vector<CandidatePair> cross_pairs;         //awake ball, sleeping ball
+	std::vector<unsigned char> hits;                //overlap test results, for cross_pairs or the coloured pairs
+	std::vector<int> found;
+
+	int sort_interval;              //steps between sorts, 0 (the default) for none. a sort changes ball indices,
+	                                //so only turn it on when callers go by ball ids (see sort_balls)
+	int steps_since_sort;
+	bool reordered;                 //the last tick sorted the balls
+	std::vector<uint32_t> sort_keys;
+	std::vector<int> sort_order;    //ball sort_order[k] moved to index k in the last sort
+	std::vector<int> sort_inverse;
+
+	bool indexing;                  //see set_indexing
+	std::shared_ptr<const SpatialIndex> spatial_index;     //latest published; only replaced with atomic_store
+	bool index_walls_stale;                                 //a wall changed since spatial_index was built
+
+	float fixed_dt;                 // > 0, in seconds
+	float accumulator;              //simulated time owed, always < fixed_dt after step()
+	long long step_count;
+
+	void advance_ball(int i, float t);
+	void sweep(float dt);
+	void resolve_overlaps();
+	void update_wall_bvh();
+	void move_walls();
+	void move_balls();
+	void bounce_off_walls(int i, std::vector<int> &candidates);
+	void resolve_overlaps_parallel();
+	void apply_forces();
+	void update_kinds();
+	void reorder_sleep_state();
+	void publish_index();
+	void colour_pairs(const std::vector<CandidatePair> &ps);
+	void collide_coloured();
+	void bounce_all_off_walls();
+
+	bool neighbours_stale() const;
+	void build_neighbours();
+	void resolve_neighbour_overlaps();
+
+	void gather(const std::vector<int> &which);
+	void update_sleep_lists();
+	void resolve_awake_overlaps();
+	void update_sleep(float dt);
+	int find_island(int i);
+	void wake_island(int i);
+	void wake_near(float left, float top, float right, float bottom);
+	void wake_near(const Wall &w, const Wall &v);
+
+public:
+	//Constructors
+	World();
+	World(sf::FloatRect a);
+	World(sf::FloatRect a, float dt);
+
+	//Getters
+	sf::FloatRect get_area() const              { return area; }
+	sf::FloatRect get_border() const            { return border; }
+	const BallSystem &get_balls() const         { return balls; }
+	BallSystem &get_balls()                     { return balls; }
+	int get_num_balls() const                   { return balls.size(); }
+	int get_num_walls() const                   { return (int)walls.size(); }
+	const Wall &get_wall(int i) const           { return walls[i]; }
+	const Wall *get_walls() const               { return walls.empty() ? 0 : &walls[0]; }
+	const WallBVH &get_wall_bvh() const         { return wall_bvh; }
+	float get_fixed_dt() const                  { return fixed_dt; }
+	long long get_step_count() const            { return step_count; }
+	float get_interpolation() const             { return accumulator / fixed_dt; }
+	bool is_continuous() const                  { return continuous; }
+	Engine get_engine() const                   { return engine; }
+	long long get_num_events() const            { return events.get_num_events(); }
+	int get_num_threads() const                 { return pool ? pool->get_num_threads() : 0; }
+	std::shared_ptr<ThreadPool> get_pool() const            { return pool; }
+	const ForceField &get_field() const         { return field; }
+	int get_num_kinds() const                   { return (int)kinds.size(); }
+	const BallBatch &get_kind(int k) const      { return *kinds[k]; }
+	float get_neighbour_skin() const            { return skin; }
+	long long get_num_neighbour_builds() const  { return neighbour_builds; }
+	bool is_sleeping() const                    { return sleeping; }
+	bool is_asleep(int i) const                 { return i<(int)asleep.size() && asleep[i]; }
+	int get_num_asleep() const                  { return num_asleep; }
+	int get_sort_interval() const               { return sort_interval; }
+	bool is_reordered() const                   { return reordered; }
+	const int *get_sort_order() const           { return sort_order.empty() ? 0 : &sort_order[0]; }
+	bool is_indexing() const                    { return indexing; }
+	int get_num_subscribers() const             { return (int)subscribers.size(); }
+	std::shared_ptr<const SpatialIndex> get_spatial_index() const       { return std::atomic_load(&spatial_index); }
+
+	//Setters
+	void set_fixed_dt(float dt);
+	void set_area(sf::FloatRect a);
+	void set_border(sf::FloatRect b);
+	void set_wall(int i, const Wall &w);
+	void set_wall_points(int i, sf::Vector2f p1, sf::Vector2f p2);
+	void set_wall_thickness(int i, float th);
+	void set_wall_motion(int i, sf::Vector2f v, float spin);
+	void set_continuous(bool c);
+	void set_engine(Engine e);
+	void set_threads(int n);
+	void set_pool(const std::shared_ptr<ThreadPool> &p)     { pool = p; }
+	void set_sleeping(bool s);
+	void set_neighbour_skin(float s);
+	void set_attraction(float g)                { field.set_strength(g); }
+	void set_opening_angle(float th)            { field.set_theta(th); }
+	void set_sort_interval(int n)               { sort_interval = n>0 ? n : 0; }
+	void set_indexing(bool on);
+	void subscribe(const std::shared_ptr<ContactStream> &s);
+	void unsubscribe(const std::shared_ptr<ContactStream> &s);
+
+	//Other functions
+	void reserve(int num_balls, int num_walls);
+	int add_ball(const Ball &b)                 { return balls.add(b); }
+	int add_ball(const Ball &b, const std::shared_ptr<BallBatch> &kind);
+	int add_ball(std::unique_ptr<Ball> b);
+	int add_wall(const Wall &w);
+	void clear();
+	void clear_balls();
+	void wake(int i);
+	void wake_all();
+	void sort_balls();
+
+	int step(sf::Time dT);
+	void tick();
+};
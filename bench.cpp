@@ -0,0 +1,155 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "ball.h"
+#include "World.h"
+#include "Scene.h"
+
+//benchmark entry point: times the hot primitives of Ball.cpp and whole scenes, one JSON object per line.
+//usage: bench [filter] [output file]
+//only benchmarks whose name contains filter are run; results go to stdout if no file is given.
+//build from bench.cpp and every other source except main.cpp, headless.cpp and determinism.cpp
+
+const double MICRO_SECONDS = 0.2;       //minimum run time of each microbenchmark
+const double SCENE_SECONDS = 1.0;       //run time of each scene benchmark (at least one step is run)
+const int INPUTS = 1024;                //distinct inputs cycled through by the microbenchmarks
+
+volatile float sink;                    //results are written here so the work is not optimised away
+
+FILE *out = stdout;
+const char *filter = "";
+
+typedef std::chrono::steady_clock bench_clock;
+
+double seconds_since(bench_clock::time_point start)
+{
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+bool selected(const char *name)
+{
+	return strstr(name, filter) != 0;
+}
+
+//runs op(i) over the inputs until MICRO_SECONDS have passed and reports the time per call
+template <class Op>
+void micro(const char *name, Op op)
+{
+	long long ops = 0;
+	int i;
+
+	if (!selected(name)) return;
+
+	bench_clock::time_point start = bench_clock::now();
+	double secs;
+	do
+	{
+		for (i = 0; i<INPUTS; i++)
+			op(i);
+		ops += INPUTS;
+	} while ((secs = seconds_since(start))<MICRO_SECONDS);
+
+	fprintf(out, "{\"benchmark\":\"%s\",\"ops\":%lld,\"ns_per_op\":%.3f}\n", name, ops, secs * 1e9 / ops);
+	fflush(out);
+}
+
+void run_micro()
+{
+	std::vector<sf::Vector2f> v(INPUTS), w(INPUTS);
+	std::vector<Ball> balls(INPUTS), others(INPUTS);
+	std::vector<Wall> walls(INPUTS);
+	int i;
+
+	for (i = 0; i<INPUTS; i++)
+	{
+		v[i] = sf::Vector2f(random_float(-100, 100), random_float(-100, 100));
+		w[i] = sf::Vector2f(random_float(-100, 100), random_float(-100, 100));
+
+		//about half of the balls overlap their partner ball and wall
+		sf::Vector2f pos(random_float(0, 200), random_float(0, 200));
+		balls[i] = Ball(pos, random_float(0, 500), random_float(0, 360), rDefault, STONE);
+		others[i] = Ball(pos + sf::Vector2f(random_float(-60, 60), random_float(-60, 60)), random_float(0, 500), random_float(0, 360), rDefault, WOOD);
+		walls[i] = Wall(pos + sf::Vector2f(random_float(-60, 60), random_float(-60, 60)), pos + sf::Vector2f(random_float(-60, 60), random_float(-60, 60)));
+	}
+
+	micro("distance", [&](int k) { sink = distance(v[k], w[k]); });
+	micro("angle", [&](int k) { sink = angle(v[k]); });
+	micro("proj", [&](int k) { sink = proj(v[k], w[k]).x; });
+	micro("is_colliding_with_ball", [&](int k) { sink = balls[k].is_colliding_with(others[k]); });
+	micro("is_colliding_with_point", [&](int k) { sink = balls[k].is_colliding_with(w[k]); });
+	micro("is_colliding_with_wall", [&](int k) { sink = balls[k].is_colliding_with(walls[k]); });
+
+	//these change their arguments, so they run on copies that are restored every INPUTS calls
+	std::vector<Ball> a(balls), b(others);
+	micro("bounce_off_wall", [&](int k) { a[k] = balls[k]; a[k].bounce_off_wall(walls[k]); sink = a[k].getx(); });
+	micro("collide_balls", [&](int k) { a[k] = balls[k]; b[k] = others[k]; collide(a[k], b[k]); sink = a[k].getx(); });
+	micro("update_position", [&](int k) { a[k].update_position(sf::seconds(FIXED_DT)); sink = a[k].getx(); });
+}
+
+//runs a random scene for SCENE_SECONDS and reports the time per step
+void scene(int n, int m, float density, int mode)
+{
+	const char *modes[3] = { "stepped", "continuous", "event" };
+	char name[128];
+	int steps = 0;
+
+	sprintf(name, "scene_%s_%d_balls_%d_walls_%.2f", modes[mode], n, m, density);
+	if (!selected(name)) return;
+
+	srand(1);
+	World world;
+	make_random_scene(world, n, m, density);
+	world.set_continuous(mode == 1);
+	world.set_engine(mode == 2 ? EVENT_ENGINE : STEPPED_ENGINE);
+	world.set_sort_interval(SORT_INTERVAL);
+
+	bench_clock::time_point start = bench_clock::now();
+	double secs;
+	do
+	{
+		world.tick();
+		steps++;
+	} while ((secs = seconds_since(start))<SCENE_SECONDS);
+
+	fprintf(out, "{\"benchmark\":\"%s\",\"engine\":\"%s\",\"balls\":%d,\"walls\":%d,\"density\":%.2f,\"steps\":%d,"
+		"\"ms_per_step\":%.4f,\"ball_steps_per_sec\":%.0f}\n",
+		name, modes[mode], n, m, density, steps, secs * 1e3 / steps, (double)steps * n / secs);
+	fflush(out);
+}
+
+void run_scenes()
+{
+	const int sizes[3] = { 1000, 10000, 100000 };
+	const int wall_counts[2] = { 10, 1000 };
+	const float densities[3] = { 0.05f, 0.25f, 0.5f };
+	int i, j, k, mode;
+
+	for (mode = 0; mode<3; mode++)
+		for (i = 0; i<3; i++)
+			for (j = 0; j<2; j++)
+				for (k = 0; k<3; k++)
+					scene(sizes[i], wall_counts[j], densities[k], mode);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc>1) filter = argv[1];
+	if (argc>2)
+	{
+		out = fopen(argv[2], "w");
+		if (!out)
+		{
+			fprintf(stderr, "cannot open %s\n", argv[2]);
+			return handle_error(1);
+		}
+	}
+
+	srand(1);
+	run_micro();
+	run_scenes();
+
+	if (out != stdout) fclose(out);
+	return 0;
+}
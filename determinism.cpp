@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "World.h"
+#include "Scene.h"
+
+//determinism check: steps the same random scenes with 0, 1, 2 and 4 threads and compares the final
+//positions and velocities bit for bit. prints one line per scene and exits with 1 if any differ.
+//usage: determinism [balls] [steps]
+//build from determinism.cpp and every other source except main.cpp, headless.cpp and bench.cpp
+
+const int THREAD_COUNTS[4] = { 0, 1, 2, 4 };
+
+//settings of one scene
+struct Setup
+{
+	const char *name;
+	float skin;
+	bool sleeping;
+	float attraction;
+};
+
+//steps a fresh copy of the scene and returns its balls' state, by id
+std::vector<float> run(const Setup &s, int n, int steps, int threads)
+{
+	World world;
+	int i;
+
+	srand(1);
+	make_random_scene(world, n, 10);
+	world.set_threads(threads);
+	world.set_neighbour_skin(s.skin);
+	world.set_sleeping(s.sleeping);
+	world.set_attraction(s.attraction);
+
+	for (i = 0; i<steps; i++)
+		world.tick();
+
+	const BallSystem &balls = world.get_balls();
+	std::vector<float> state(4 * balls.size());
+	for (i = 0; i<balls.size(); i++)
+	{
+		int k = balls.get_index(i);
+		state[4 * i] = balls.get_position(k).x;
+		state[4 * i + 1] = balls.get_position(k).y;
+		state[4 * i + 2] = balls.get_velocity(k).x;
+		state[4 * i + 3] = balls.get_velocity(k).y;
+	}
+	return state;
+}
+
+int main(int argc, char *argv[])
+{
+	int n = argc>1 ? atoi(argv[1]) : 2000;
+	int steps = argc>2 ? atoi(argv[2]) : 300;
+	const Setup setups[4] = {
+		{ "grid", 0, false, 0 },
+		{ "neighbour_lists", 5, false, 0 },
+		{ "sleeping", 0, true, 0 },
+		{ "attraction", 0, false, 50 } };
+	bool same = true;
+	int s, t;
+
+	for (s = 0; s<4; s++)
+	{
+		std::vector<float> first = run(setups[s], n, steps, THREAD_COUNTS[0]);
+		bool ok = true;
+
+		for (t = 1; t<4; t++)
+		{
+			std::vector<float> other = run(setups[s], n, steps, THREAD_COUNTS[t]);
+			if (other.size() != first.size() || (!first.empty() && memcmp(&other[0], &first[0], first.size() * sizeof(float)) != 0))
+			{
+				printf("%s: %d threads differ from %d\n", setups[s].name, THREAD_COUNTS[t], THREAD_COUNTS[0]);
+				ok = false;
+			}
+		}
+		if (ok) printf("%s: same for 0, 1, 2 and 4 threads\n", setups[s].name);
+		same = same && ok;
+	}
+	return same ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include "World.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "Replay.h"
+
+//headless entry point: simulates a random scene without opening a window and reports throughput.
+//usage: headless [balls] [walls] [steps] [seed] [mode: 0 stepped, 1 continuous, 2 event-driven] [threads] [skin] [replay file]
+//build from headless.cpp and every other source except main.cpp, bench.cpp and determinism.cpp; only sf::Vector2f,
+//sf::Color and sf::Time are used, so no display is required
+
+int main(int argc, char *argv[])
+{
+	int n = argc>1 ? atoi(argv[1]) : 10000;
+	int m = argc>2 ? atoi(argv[2]) : 10;
+	int steps = argc>3 ? atoi(argv[3]) : 1000;
+	unsigned seed = argc>4 ? (unsigned)atoi(argv[4]) : 1;
+	int mode = argc>5 ? atoi(argv[5]) : 0;
+	int threads = argc>6 ? atoi(argv[6]) : 0;
+	float skin = argc>7 ? (float)atof(argv[7]) : 0;
+	Recorder recorder;
+	int i;
+
+	srand(seed);
+
+	World world;
+	make_random_scene(world, n, m);
+	world.set_continuous(mode == 1);
+	world.set_engine(mode == 2 ? EVENT_ENGINE : STEPPED_ENGINE);
+	world.set_threads(threads);
+	world.set_neighbour_skin(skin);
+
+	//every step is recorded, delta-encoded, if a replay file is given. the simulation waits for the
+	//writer rather than leaving gaps in the replay
+	recorder.set_blocking(true);
+	if (argc>8 && !recorder.open(argv[8], world, REPLAY_DELTA))
+		printf("cannot create %s\n", argv[8]);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (i = 0; i<steps; i++)
+	{
+		world.tick();
+		recorder.record(world);
+		PROFILE_END_FRAME();
+	}
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("balls %d walls %d steps %d mode %d threads %d skin %g time %.3f s\n", n, m, steps, mode, threads, skin, secs);
+	if (recorder.is_open()) printf("recorded %lld frames, dropped %lld\n", recorder.get_num_recorded(), recorder.get_num_dropped());
+	recorder.close();
+	printf("steps/sec %.1f ball-steps/sec %.0f\n", steps / secs, (double)steps * n / secs);
+
+#ifdef BALL_PROFILING
+	get_profiler().write_json(std::cout);
+#endif
+
+	return 0;
+}
@@ -1,5 +1,11 @@
 #include <SFML/Graphics.hpp>
 #include "ball.h"
+#include "World.h"
+#include "PhysicsThread.h"
+#include "Replay.h"
+#include "Scene.h"
+#include "BatchRenderer.h"
+#include "Profiler.h"
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
@@ -7,7 +13,9 @@ const int NUM_BALLS = 5;
 const int NUM_WALLS = 2;
 const int BT = 8;           //border thickness
 
-int main()
+//with a replay file as the argument, plays it back at recorded speed instead of simulating;
+//with a scene file, simulates that scene instead of the demo one
+int main(int argc, char *argv[])
 {
 	sf::RenderWindow theWindow(sf::VideoMode(WIDTH + 2 * BT, HEIGHT + 2 * BT),"Ball Demo");
 	sf::RectangleShape border;
@@ -17,6 +25,8 @@ int main()
 	border.setOutlineColor(sf::Color::Cyan);
 	border.setFillColor(sf::Color::Transparent);
 
+	int i;
+
 	Ball bs[NUM_BALLS];
 	Wall ws[NUM_WALLS];
 
@@ -36,12 +46,38 @@ int main()
 
 	//ws[0].set_points(sf::Vector2f(300, 200), sf::Vector2f(360, 270));
 
+	World world(sf::FloatRect(BT, BT, WIDTH, HEIGHT));
+	for (i = 0; i<NUM_BALLS; i++)
+		world.add_ball(bs[i]);
+	for (i = 0; i<NUM_WALLS; i++)
+		world.add_wall(ws[i]);
+
+	//one pool of worker threads serves both the physics steps and the vertex updates. the physics
+	//thread and this one work in the pool's loops too, each from a queue of its own, so the pool
+	//counts one of them and starts a worker fewer than there are cores for the other
+	int cores = (int)std::thread::hardware_concurrency();
+	std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(cores - 1);
+	world.set_pool(pool);
+
+	BatchRenderer renderer;
+	renderer.set_pool(pool);
+
+#ifdef BALL_PROFILING
+	//the profiler overlay is labelled only if a font is available
+	sf::Font font;
+	bool has_font = font.loadFromFile("arial.ttf");
+#endif
+
+	Player player;
+	bool replaying = argc>1 && player.open(argv[1]);
+	if (argc>1 && !replaying && load_scene(world, argv[1]) != 0)
+		return handle_error(1);
+	long long first_step = replaying && player.get_num_frames()>0 ? player.get_step(0) : 0;
 	sf::Clock theClock;
-	sf::Time elps;
 
-	int i, j;
-	float r;
-	sf::Vector2f pos, vel;
+	//physics runs on its own thread from here on; the loop below only draws its snapshots
+	PhysicsThread physics(world);
+	if (!replaying) physics.start();
 
 	while (theWindow.isOpen())
 	{
@@ -52,44 +88,33 @@ int main()
 				theWindow.close();
 		}
 
-		elps = theClock.getElapsedTime();
-		theClock.restart();
+		theWindow.clear(sf::Color::Blue);
+		theWindow.draw(border);
 
-		for (i = 0; i<NUM_BALLS; i++)
 		{
-			bs[i].update_position(elps);
-			pos = bs[i].get_position();
-			vel = bs[i].get_velocity();
-			r = bs[i].get_radius();
-
-			if ((pos.x<BT + r && vel.x<0) || (pos.x>WIDTH + BT - r && vel.x>0))
-				bs[i].bounce(0);
-			if ((pos.y<BT + r && vel.y<0) || (pos.y>HEIGHT + BT - r && vel.y>0))
-				bs[i].bounce(90);
-
-			for (j = 0; j<i; j++)
+			PROFILE_PHASE(RENDER_PHASE);
+			if (replaying)
 			{
-				if (bs[i].is_colliding_with(bs[j]))
-					collide(bs[i], bs[j]);
+				//frames are found by step, since a replay may have gaps where frames were dropped
+				double t = theClock.getElapsedTime().asSeconds() / player.get_fixed_dt();
+				renderer.update(player.seek_step(first_step + (long long)t), (float)(t - (long long)t));
 			}
-			for (j = 0; j<NUM_WALLS; j++)
+			else
 			{
-				if (bs[i].is_colliding_with(ws[j]))
-					collide(bs[i], ws[j]);
+				physics.acquire();
+				renderer.update(physics.get_snapshot(), physics.get_interpolation(physics.get_snapshot()));
 			}
+			theWindow.draw(renderer);
 		}
 
-		theWindow.clear(sf::Color::Blue);
-		theWindow.draw(border);
-
-		for (i = 0; i<NUM_WALLS; i++)
-			theWindow.draw(ws[i].get_rectangleShape());
-
-		for (i = 0; i<NUM_BALLS; i++)
-			theWindow.draw(bs[i].get_circleShape());
+#ifdef BALL_PROFILING
+		get_profiler().draw_overlay(theWindow, has_font ? &font : 0);
+#endif
+		PROFILE_END_FRAME();
 
 		theWindow.display();
 	}
 
+	physics.stop();
 	return 0;
 }
\ No newline at end of file